@@ -29,6 +29,7 @@
 #include "context.hpp"
 #include "solver.hpp"
 #include "triton_logic.hpp"
+#include "memory_cache.hpp"
 
 //Triton
 #include "triton/api.hpp"
@@ -39,6 +40,8 @@ int taint_symbolize_register(const qstring& selected, action_activation_ctx_t* a
 
     if (reg_id_to_symbolize != triton::arch::register_e::ID_REG_INVALID) {
         auto register_to_symbolize = api.getRegister(reg_id_to_symbolize);
+        //The solver job reads the engine we are about to change
+        stop_solver_job();
         /*When the user symbolize something for the first time we should enable step_tracing*/
         start_tainting_or_symbolic_analysis();
 
@@ -49,6 +52,10 @@ int taint_symbolize_register(const qstring& selected, action_activation_ctx_t* a
         char comment[256];
         qsnprintf(comment, 256, "Reg %s at address: " MEM_FORMAT, selected.c_str(), pc);
 
+        trace_recorder.recordSymbolizeRegister(register_to_symbolize);
+        //The user could have edited the register since the last debugger event
+        invalidate_register_cache();
+
         // Before symbolizing register we should set his concrete value
         needConcreteRegisterValue_cb(api, register_to_symbolize);
 
@@ -61,6 +68,7 @@ int taint_symbolize_register(const qstring& selected, action_activation_ctx_t* a
 
 
         tritonize(pc);
+        flush_annotations();
         return 0;
     }
     return 0;
@@ -197,12 +205,18 @@ struct ah_taint_symbolize_memory_t : public action_handler_t
         if (!prompt_window_taint_symbolize(current_ea, abs(size), &selection_starts, &selection_ends))
             return 0;
 
+        //The solver job reads the engine we are about to change
+        stop_solver_job();
         /* When the user taints something for the first time we should enable step_tracing*/
         start_tainting_or_symbolic_analysis();
 
         auto selection_length = selection_ends - selection_starts;
         msg("[+] %s memory from " MEM_FORMAT " to " MEM_FORMAT ". Total: %d bytes\n", cmdOptions.use_tainting_engine ? "Tainting" : "Symbolizing",  selection_starts, selection_ends, (int)selection_length);
 
+        trace_recorder.recordSymbolizeMemory(selection_starts, (triton::uint32)selection_length);
+        //The user could have edited the memory since the last debugger event
+        invalidate_memory_cache();
+
         // Before symbolizing the memory we should set its concrete value
         for (unsigned int i = 0; i < selection_length; i++) {
             needConcreteMemoryValue_cb(api, triton::arch::MemoryAccess(selection_starts + i, 1));
@@ -225,6 +239,7 @@ struct ah_taint_symbolize_memory_t : public action_handler_t
         }
 
         tritonize(current_instruction());
+        flush_annotations();
 
         // Reset tracer timing counter since user was using IDA and not just tracing
         ponce_runtime_status.tracing_start_time = GetTimeMs64();
@@ -301,6 +316,26 @@ action_desc_t action_IDA_taint_symbolize_memory = ACTION_DESC_LITERAL(
     "Symbolize the selected register", //Optional: the action tooltip (available in menus/toolbar)
     50); //Optional: the action icon (shows when in menus/toolbars)
 
+/*First path constraint of the branch at address with a non taken branch, and the destination of that branch.
+Returns false if there is none*/
+static bool get_non_taken_branch(ea_t address, size_t& path_constraint_index, triton::uint64& non_taken_addr)
+{
+    const std::vector<size_t>* branches = branch_index.getBranches(address);
+    if (branches == nullptr)
+        return false;
+    const auto& pathConstraints = api.getPathConstraints();
+    for (size_t index : *branches) {
+        for (auto const& [taken, srcAddr, dstAddr, pc] : pathConstraints[index].getBranchConstraints()) {
+            if (address == srcAddr && !taken) {
+                path_constraint_index = index;
+                non_taken_addr = dstAddr;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
 struct ah_negate_and_inject_t : public action_handler_t
 {
     virtual int idaapi activate(action_activation_ctx_t* action_activation_ctx)
@@ -318,8 +353,10 @@ struct ah_negate_and_inject_t : public action_handler_t
             if (cmdOptions.showDebugInfo)
                 msg("[+] Negating condition at " MEM_FORMAT "\n", action_activation_ctx->cur_ea);
 
-            std::thread t(negate_inject_maybe_restore_solver, action_activation_ctx->cur_ea, symbolic_condition_index, false);
-            t.detach();            
+            ea_t pc = action_activation_ctx->cur_ea;
+            start_solver_job("Negating the condition", [pc, symbolic_condition_index]() {
+                return negate_inject_maybe_restore_solver(pc, symbolic_condition_index, false);
+            });
         }
 
         // Reset tracer timing counter since user was using IDA and not just tracing
@@ -337,22 +374,18 @@ struct ah_negate_and_inject_t : public action_handler_t
                 ponce_runtime_status.last_triton_instruction->isBranch() &&
                 ponce_runtime_status.last_triton_instruction->isSymbolized()) {
 
-                unsigned int path_constraint_index = 0;
-                for (const auto& pc : api.getPathConstraints()) {
-                    for (auto const& [taken, srcAddr, dstAddr, pc] : pc.getBranchConstraints()) {
-                        if (ctx->cur_ea == srcAddr && !taken) {
-                            char tooltip[256];
-                            //We need the path constraint index during the action activate
-                            qsnprintf(tooltip, 255, "Index: %u", path_constraint_index);
-                            update_action_tooltip(ctx->action, tooltip);
-
-                            char label[100] = { 0 };
-                            qsnprintf(label, sizeof(label), "Negate and Inject to reach " MEM_FORMAT, dstAddr);
-                            update_action_label(ctx->action, label);
-                            return AST_ENABLE;
-                        }
-                    }
-                    path_constraint_index++;
+                size_t path_constraint_index;
+                triton::uint64 dstAddr;
+                if (get_non_taken_branch(ctx->cur_ea, path_constraint_index, dstAddr)) {
+                    char tooltip[256];
+                    //We need the path constraint index during the action activate
+                    qsnprintf(tooltip, 255, "Index: %u", (unsigned int)path_constraint_index);
+                    update_action_tooltip(ctx->action, tooltip);
+
+                    char label[100] = { 0 };
+                    qsnprintf(label, sizeof(label), "Negate and Inject to reach " MEM_FORMAT, dstAddr);
+                    update_action_label(ctx->action, label);
+                    return AST_ENABLE;
                 }
             }
         }
@@ -388,8 +421,10 @@ struct ah_negate_inject_and_restore_t : public action_handler_t
             if (cmdOptions.showDebugInfo)
                 msg("[+] Negating condition at " MEM_FORMAT "\n", action_activation_ctx->cur_ea);
 
-            std::thread t(negate_inject_maybe_restore_solver, action_activation_ctx->cur_ea, symbolic_condition_index, true);
-            t.detach();
+            ea_t pc = action_activation_ctx->cur_ea;
+            start_solver_job("Negating the condition", [pc, symbolic_condition_index]() {
+                return negate_inject_maybe_restore_solver(pc, symbolic_condition_index, true);
+            });
         }
         // Reset tracer timing counter since user was using IDA and not just tracing
         ponce_runtime_status.tracing_start_time = GetTimeMs64();
@@ -406,16 +441,18 @@ struct ah_negate_inject_and_restore_t : public action_handler_t
                 ponce_runtime_status.last_triton_instruction->isBranch() &&
                 ponce_runtime_status.last_triton_instruction->isSymbolized()) {
 
-
-                for (const auto& pc : api.getPathConstraints()) {
-                    for (auto const& [taken, srcAddr, dstAddr, pc] : pc.getBranchConstraints()) {
-                        if (ctx->cur_ea == srcAddr) {
-                            char label[100] = { 0 };
-                            qsnprintf(label, sizeof(label), "Negate, Inject to reach " MEM_FORMAT " & Restore snapshot", dstAddr);
-                            update_action_label(ctx->action, label);
-                            return AST_ENABLE;
-                        }
-                    }
+                size_t path_constraint_index;
+                triton::uint64 dstAddr;
+                if (get_non_taken_branch(ctx->cur_ea, path_constraint_index, dstAddr)) {
+                    char tooltip[256];
+                    //We need the path constraint index during the action activate
+                    qsnprintf(tooltip, 255, "Index: %u", (unsigned int)path_constraint_index);
+                    update_action_tooltip(ctx->action, tooltip);
+
+                    char label[100] = { 0 };
+                    qsnprintf(label, sizeof(label), "Negate, Inject to reach " MEM_FORMAT " & Restore snapshot", dstAddr);
+                    update_action_label(ctx->action, label);
+                    return AST_ENABLE;
                 }
             }
         }
@@ -444,12 +481,14 @@ struct ah_create_snapshot_t : public action_handler_t
             return 0;
         }
 
-        ponce_set_cmt(xip, "Snapshot taken here", false, true);
-        ponce_set_item_color(xip, 0x00FFFF);
+        qstring name;
+        name.sprnt("%u", (unsigned int)snapshot.getNumberOfSnapshots() + 1);
+        if (!ask_str(&name, HIST_IDENT, "Snapshot name"))
+            return 0;
 
-        snapshot.takeSnapshot();
-        snapshot.setAddress(xip); // We will use this address later to delete the comment
-        msg("Snapshot Taken\n");
+        // The snapshot is a child of the last snapshot taken or restored
+        snapshot.takeSnapshot(name.c_str(), xip);
+        msg("Snapshot %s Taken\n", name.c_str());
 
         // Reset tracer timing counter since user was using IDA and not just tracing
         ponce_runtime_status.tracing_start_time = GetTimeMs64();
@@ -458,8 +497,8 @@ struct ah_create_snapshot_t : public action_handler_t
 
     virtual action_state_t idaapi update(action_update_ctx_t* ctx)
     {
-        //Only if process is being debugged and there is not previous snaphot
-        if (is_debugger_on() && !snapshot.exists())
+        //Only if process is being debugged
+        if (is_debugger_on())
             return AST_ENABLE;
         else
             return AST_DISABLE;
@@ -475,12 +514,50 @@ static const action_desc_t action_IDA_createSnapshot = ACTION_DESC_LITERAL(
     NULL,
     129);
 
+//Lists the snapshot tree so the user can choose one
+struct snapshot_chooser_t : public chooser_t
+{
+protected:
+    static const int widths_[];
+    static const char* const header_[];
+
+public:
+    snapshot_chooser_t() : chooser_t(CH_MODAL | CH_KEEP, qnumber(widths_), widths_, header_, "Ponce snapshots") {}
+
+    virtual size_t idaapi get_count() const { return snapshot.getNumberOfSnapshots(); }
+
+    virtual void idaapi get_row(qstrvec_t* cols, int* icon_, chooser_item_attrs_t* attrs, size_t n) const
+    {
+        const snapshot_node_t& node = snapshot.getSnapshot(n);
+        qstrvec_t& cols_ = *cols;
+        cols_[0].sprnt("%s%s", node.name.c_str(), (ssize_t)n == snapshot.getCurrent() ? " (current)" : "");
+        cols_[1].sprnt(MEM_FORMAT, node.address);
+        if (node.parent >= 0)
+            cols_[2] = snapshot.getSnapshot(node.parent).name.c_str();
+        cols_[3].sprnt("%u", node.saved_ponce_runtime_status.total_number_traced_ins);
+        cols_[4].sprnt("%u", (unsigned int)node.path_constraints);
+        cols_[5].sprnt("%u", (unsigned int)node.old_memory.size());
+    }
+};
+
+const int snapshot_chooser_t::widths_[] = { 20, 16, 20, 12, 12, 12 };
+const char* const snapshot_chooser_t::header_[] = { "Name", "Address", "Parent", "Traced instructions", "Path constraints", "Memory runs" };
+
 struct ah_restore_snapshot_t : public action_handler_t
 {
     virtual int idaapi activate(action_activation_ctx_t* ctx)
     {
-        snapshot.restoreSnapshot();
-        msg("Snapshot restored\n");
+        size_t id = 0;
+        // With more than one snapshot the user chooses which one
+        if (snapshot.getNumberOfSnapshots() > 1) {
+            snapshot_chooser_t chooser;
+            ssize_t chosen = chooser.choose(snapshot.getCurrent());
+            if (chosen < 0)
+                return 0;
+            id = (size_t)chosen;
+        }
+        snapshot.restoreSnapshot(id);
+        msg("Snapshot %s restored\n", snapshot.getSnapshot(id).name.c_str());
 
         // Reset tracer timing counter since user was using IDA and not just tracing
         ponce_runtime_status.tracing_start_time = GetTimeMs64();
@@ -511,7 +588,7 @@ struct ah_delete_snapshot_t : public action_handler_t
     virtual int idaapi activate(action_activation_ctx_t* ctx)
     {
         snapshot.resetEngine();
-        msg("[+] Snapshot removed\n");
+        msg("[+] Snapshots removed\n");
 
         // Reset tracer timing counter since user was using IDA and not just tracing
         ponce_runtime_status.tracing_start_time = GetTimeMs64();
@@ -531,12 +608,57 @@ static ah_delete_snapshot_t ah_delete_snapshot;
 
 static const action_desc_t action_IDA_deleteSnapshot = ACTION_DESC_LITERAL(
     "Ponce:delete_snapshot",
-    "Delete Execution Snapshot",
+    "Delete Execution Snapshots",
     &ah_delete_snapshot,
     "Ctrl+Shift+D",
     NULL,
     130);
 
+struct ah_record_trace_t : public action_handler_t
+{
+    virtual int idaapi activate(action_activation_ctx_t* ctx)
+    {
+        if (trace_recorder.isRecording()) {
+            trace_recorder.stop();
+            return 0;
+        }
+
+        char* path = ask_file(true, "*.ptrace", "Save the execution trace as");
+        if (path == NULL)
+            return 0;
+
+        int answer = ask_yn(ASKBTN_NO, "Do you want to defer the symbolic processing to the replay?\nTracing will be faster but Ponce will not annotate the executed instructions.");
+        if (answer == ASKBTN_CANCEL)
+            return 0;
+
+        trace_recorder.start(path, answer == ASKBTN_YES);
+        return 0;
+    }
+
+    virtual action_state_t idaapi update(action_update_ctx_t* ctx)
+    {
+        //Only if process is being debugged
+        if (is_debugger_on()) {
+            //We are using this event to change the text of the action
+            if (trace_recorder.isRecording())
+                update_action_label(ctx->action, "Stop recording trace");
+            else
+                update_action_label(ctx->action, "Start recording trace");
+            return AST_ENABLE;
+        }
+        return AST_DISABLE;
+    }
+};
+static ah_record_trace_t ah_record_trace;
+
+static const action_desc_t action_IDA_record_trace = ACTION_DESC_LITERAL(
+    "Ponce:record_trace",
+    "Start recording trace",
+    &ah_record_trace,
+    NULL,
+    "Record the executed instructions and the values read from the debugger to replay them offline",
+    53);
+
 struct ah_show_config_t : public action_handler_t
 {
     virtual int idaapi activate(action_activation_ctx_t* ctx)
@@ -637,6 +759,8 @@ struct ah_action_chooser_add_constrain_t : public action_handler_t
         }
 
 
+        //The solver job could be building nodes in the same AST context
+        stop_solver_job();
         auto ast = api.getAstContext();
         for (const auto& index : ctx->chooser_selection) {
             triton::ast::SharedAbstractNode ge, le;
@@ -823,6 +947,7 @@ struct ah_enable_disable_tracing_t : public action_handler_t
             // Ponce was not running (enable tracing)
             start_tainting_or_symbolic_analysis();
             tritonize(current_instruction());
+            flush_annotations();
             if (cmdOptions.showDebugInfo)
                 msg("[+] Enabling step tracing\n");
         }
@@ -876,9 +1001,12 @@ struct ah_solve_formula_sub_t : public action_handler_t
         if (cmdOptions.showDebugInfo)
             msg("[+] Solving condition at address " MEM_FORMAT " with symbolic condition index %d\n", ctx->cur_ea, path_constraint_index);
         
-        std::thread t(solve_formula, ctx->cur_ea, path_constraint_index);
-        t.detach();
-        
+        ea_t pc = ctx->cur_ea;
+        start_solver_job("Solving the condition", [pc, path_constraint_index]() {
+            solve_formula(pc, path_constraint_index);
+            return solver_job_result_t();
+        });
+
         // Reset tracer timing counter since user was using IDA and not just tracing
         ponce_runtime_status.tracing_start_time = GetTimeMs64();
         return 0;
@@ -920,8 +1048,11 @@ struct ah_solve_formula_choose_index_sub_t : public action_handler_t
             if (cmdOptions.showDebugInfo)
                 msg("[+] Solving condition at address " MEM_FORMAT " with symbolic condition index %d\n", ctx->cur_ea, path_constraint_index);
             
-            std::thread t(solve_formula, ctx->cur_ea, path_constraint_index);
-            t.detach();
+            ea_t pc = ctx->cur_ea;
+            start_solver_job("Solving the condition", [pc, path_constraint_index]() {
+                solve_formula(pc, path_constraint_index);
+                return solver_job_result_t();
+            });
         }
 
         // Reset tracer timing counter since user was using IDA and not just tracing
@@ -947,6 +1078,108 @@ action_desc_t action_IDA_solve_formula_choose_index_sub = ACTION_DESC_LITERAL(
     13); //Optional: the action icon (shows when in menus/toolbars)
 
 
+struct ah_solve_all_branches_t : public action_handler_t
+{
+    virtual int idaapi activate(action_activation_ctx_t* ctx)
+    {
+        start_solver_job("Solving every branch", []() {
+            solve_all_branches_and_report();
+            return solver_job_result_t();
+        });
+
+        // Reset tracer timing counter since user was using IDA and not just tracing
+        ponce_runtime_status.tracing_start_time = GetTimeMs64();
+        return 0;
+    }
+
+    virtual action_state_t idaapi update(action_update_ctx_t* ctx)
+    {
+        if (is_debugger_on() && !api.getPathConstraints().empty())
+            return AST_ENABLE;
+        return AST_DISABLE;
+    }
+};
+ah_solve_all_branches_t ah_solve_all_branches;
+
+action_desc_t action_IDA_solve_all_branches = ACTION_DESC_LITERAL(
+    "Ponce:solve_all_branches", // The action name. This acts like an ID and must be unique
+    "Solve all branches", //The action text.
+    &ah_solve_all_branches, //The action handler.
+    "", //Optional: the action shortcut
+    "Solve the negation of every symbolic branch of the path and show the new inputs ranked", //Optional: the action tooltip (available in menus/toolbar)
+    13); //Optional: the action icon (shows when in menus/toolbars)
+
+
+/* Default number of models asked to the user */
+#define DEFAULT_MAX_MODELS 16
+
+struct ah_enumerate_models_t : public action_handler_t
+{
+    virtual int idaapi activate(action_activation_ctx_t* ctx)
+    {
+        // The last time the branch was executed
+        const std::vector<size_t>* branches = branch_index.getBranches(ctx->cur_ea);
+        if (branches == nullptr || branches->empty())
+            return 0;
+        size_t path_constraint_index = branches->back();
+
+        sval_t max_models = DEFAULT_MAX_MODELS;
+        if (!ask_long(&max_models, "Maximum number of models") || max_models <= 0)
+            return 0;
+
+        ea_t pc = ctx->cur_ea;
+        start_solver_job("Enumerating models", [pc, path_constraint_index, max_models]() {
+            return enumerate_and_pick(pc, path_constraint_index, (size_t)max_models);
+        });
+
+        // Reset tracer timing counter since user was using IDA and not just tracing
+        ponce_runtime_status.tracing_start_time = GetTimeMs64();
+        return 0;
+    }
+
+    virtual action_state_t idaapi update(action_update_ctx_t* ctx)
+    {
+        if (is_debugger_on()) {
+            const std::vector<size_t>* branches = branch_index.getBranches(ctx->cur_ea);
+            if (branches != nullptr && !branches->empty())
+                return AST_ENABLE;
+        }
+        return AST_DISABLE;
+    }
+};
+ah_enumerate_models_t ah_enumerate_models;
+
+action_desc_t action_IDA_enumerate_models = ACTION_DESC_LITERAL(
+    "Ponce:enumerate_models", // The action name. This acts like an ID and must be unique
+    "Enumerate models", //The action text.
+    &ah_enumerate_models, //The action handler.
+    "", //Optional: the action shortcut
+    "Find several inputs for the condition (every target of a switch table) and pick one to inject", //Optional: the action tooltip (available in menus/toolbar)
+    13); //Optional: the action icon (shows when in menus/toolbars)
+
+struct ah_cancel_solving_t : public action_handler_t
+{
+    virtual int idaapi activate(action_activation_ctx_t* ctx)
+    {
+        cancel_solver_job();
+        return 0;
+    }
+
+    virtual action_state_t idaapi update(action_update_ctx_t* ctx)
+    {
+        return is_solver_job_running() ? AST_ENABLE : AST_DISABLE;
+    }
+};
+ah_cancel_solving_t ah_cancel_solving;
+
+action_desc_t action_IDA_cancel_solving = ACTION_DESC_LITERAL(
+    "Ponce:cancel_solving", // The action name. This acts like an ID and must be unique
+    "Cancel solving", //The action text.
+    &ah_cancel_solving, //The action handler.
+    "", //Optional: the action shortcut
+    "Interrupt the solver and discard its results", //Optional: the action tooltip (available in menus/toolbar)
+    -1); //Optional: the action icon (shows when in menus/toolbars)
+
 
 struct ah_ponce_banner_t : public action_handler_t
 {
@@ -1024,11 +1257,16 @@ struct IDA_actions action_list[] =
     // Solve formula is handled separatly to be more user friendly
     // But still we want to register it in advance so it is always disable, so we define no views
     { &action_IDA_solve_formula_sub, { __END__ }, "SMT Solver/" },
+    { &action_IDA_solve_all_branches, { BWN_DISASM, __END__ }, "SMT Solver/" },
+    { &action_IDA_enumerate_models, { BWN_DISASM, __END__ }, "SMT Solver/" },
+    { &action_IDA_cancel_solving, { BWN_DISASM, __END__ }, "SMT Solver/" },
 
     { &action_IDA_createSnapshot, { BWN_DISASM, __END__ }, "Snapshot/"},
     { &action_IDA_restoreSnapshot, { BWN_DISASM, __END__ }, "Snapshot/" },
     { &action_IDA_deleteSnapshot, { BWN_DISASM, __END__ }, "Snapshot/" },
 
+    { &action_IDA_record_trace, { BWN_DISASM, __END__ }, "Trace/" },
+
     { &action_chooser_comment, { BWN_CHOOSER, __END__ }, "" },
     { &action_chooser_add_constrain, { BWN_CHOOSER, __END__ }, "" },
 
@@ -46,6 +46,9 @@ extern action_desc_t action_IDA_taint_symbolize_register;
 extern action_desc_t action_IDA_taint_symbolize_memory;
 extern action_desc_t action_IDA_ponce_banner;
 extern action_desc_t action_IDA_solve_formula_choose_index_sub;
+extern action_desc_t action_IDA_solve_all_branches;
+extern action_desc_t action_IDA_enumerate_models;
+extern action_desc_t action_IDA_cancel_solving;
 
 
 #define SYMBOLIC "Symbolic/"
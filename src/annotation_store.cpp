@@ -0,0 +1,38 @@
+//! \file
+/*
+**  Copyright (c) 2020 - Ponce
+**  Authors:
+**         Alberto Garcia Illera        agarciaillera@gmail.com
+**         Francisco Oca                francisco.oca.gonzalez@gmail.com
+**
+**  This program is under the terms of the BSD License.
+*/
+
+//Ponce
+#include "annotation_store.hpp"
+
+instruction_info& AnnotationStore::get(ea_t ea) {
+    return this->annotations[ea];
+}
+
+
+void AnnotationStore::forEachInFunction(func_t* func, const std::function<void(ea_t, const instruction_info&)>& callback) const {
+    if (func == nullptr)
+        return;
+    func_tail_iterator_t fti(func);
+    for (bool ok = fti.first(); ok; ok = fti.next()) {
+        const range_t& chunk = fti.chunk();
+        for (auto it = this->annotations.lower_bound(chunk.start_ea); it != this->annotations.end() && it->first < chunk.end_ea; ++it)
+            callback(it->first, it->second);
+    }
+}
+
+
+const std::map<ea_t, instruction_info>& AnnotationStore::getAll(void) const {
+    return this->annotations;
+}
+
+
+void AnnotationStore::clear(void) {
+    this->annotations.clear();
+}
@@ -0,0 +1,53 @@
+//! \file
+/*
+**  Copyright (c) 2020 - Ponce
+**  Authors:
+**         Alberto Garcia Illera        agarciaillera@gmail.com
+**         Francisco Oca                francisco.oca.gonzalez@gmail.com
+**
+**  This program is under the terms of the BSD License.
+*/
+
+/*The comments and colors Ponce added, by address. The Hex-Rays callback asks for the ones of a function every time
+it is printed, so they are looked up by the address ranges of the function chunks instead of going through all of them.
+The functions are not known while tracing (and the user can create or change them later), that's why the store is
+ordered by address and not grouped by function*/
+
+#pragma once
+
+#include <functional>
+#include <map>
+#include <string>
+
+//IDA
+#include <ida.hpp>
+#include <funcs.hpp>
+
+struct instruction_info {
+    std::string comment;
+    std::string snapshot_comment;
+    bgcolor_t color = DEFCOLOR;
+
+};
+
+//! \class AnnotationStore
+//! \brief The annotations of the instructions, ordered by address.
+class AnnotationStore {
+
+private:
+    //! Annotation of every address.
+    std::map<ea_t, instruction_info> annotations;
+
+public:
+    //! Returns the annotation of an address, an empty one is created if it does not exist.
+    instruction_info& get(ea_t ea);
+
+    //! Calls callback for every annotation inside the chunks of the function, in address order.
+    void forEachInFunction(func_t* func, const std::function<void(ea_t, const instruction_info&)>& callback) const;
+
+    //! All the annotations.
+    const std::map<ea_t, instruction_info>& getAll(void) const;
+
+    //! Forgets every annotation.
+    void clear(void);
+};
@@ -0,0 +1,87 @@
+//! \file
+/*
+**  Copyright (c) 2020 - Ponce
+**  Authors:
+**         Alberto Garcia Illera        agarciaillera@gmail.com
+**         Francisco Oca                francisco.oca.gonzalez@gmail.com
+**
+**  This program is under the terms of the BSD License.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <set>
+#include <thread>
+#include <utility>
+
+#include "batch_solver.hpp"
+#include "incremental_solver.hpp"
+
+/*Returns the new inputs for every non taken branch of the path constraints, ranked: first the ones reaching
+code the current path never reached, then by path constraint index (the shallower the branch, the more
+of the current path the input keeps).
+Branches seen more than once (loops) are only solved the first time.
+Every worker thread has its own solver since a Z3 context can not be shared between threads, the cache is shared*/
+std::vector<batch_input_t> solve_all_branches(triton::API& api, unsigned int threads, const triton::ast::SharedAbstractNode& extra_constraints, QueryCache* cache,
+    const solver_limits_t& limits, SolverGroup* group)
+{
+    const auto& pathConstraints = api.getPathConstraints();
+
+    // The code reached by the current path and the path constraints with a branch not tried yet
+    std::set<triton::uint64> reached;
+    std::set<std::pair<triton::uint64, triton::uint64>> queued;
+    std::vector<size_t> indexes;
+    for (size_t i = 0; i < pathConstraints.size(); i++) {
+        bool new_branch = false;
+        for (auto const& [taken, srcAddr, dstAddr, constraint] : pathConstraints[i].getBranchConstraints()) {
+            if (taken)
+                reached.insert(dstAddr);
+            else if (queued.emplace(srcAddr, dstAddr).second)
+                new_branch = true;
+        }
+        if (new_branch)
+            indexes.push_back(i);
+    }
+
+    std::vector<std::vector<branch_model_t>> models(indexes.size());
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        IncrementalSolver solver(cache);
+        solver.setLimits(limits);
+        // The solver leaves the group before it is destroyed, also when Z3 throws
+        struct membership_t {
+            SolverGroup* group;
+            IncrementalSolver* solver;
+            ~membership_t() {
+                if (group)
+                    group->remove(solver);
+            }
+        } membership = { group, &solver };
+        if (group)
+            group->add(&solver);
+        for (size_t i = next++; i < indexes.size() && !solver.isInterrupted(); i = next++)
+            models[i] = solver.solve(api, indexes[i], extra_constraints);
+    };
+
+    threads = std::max(1u, std::min(threads, (unsigned int)indexes.size()));
+    std::vector<std::thread> pool;
+    for (unsigned int i = 1; i < threads; i++)
+        pool.emplace_back(worker);
+    worker();
+    for (auto& thread : pool)
+        thread.join();
+
+    std::vector<batch_input_t> inputs;
+    std::set<std::pair<triton::uint64, triton::uint64>> solved;
+    for (size_t i = 0; i < indexes.size(); i++) {
+        for (auto& [srcAddr, dstAddr, model] : models[i]) {
+            if (model.empty() || !solved.emplace(srcAddr, dstAddr).second)
+                continue;
+            inputs.push_back({ indexes[i], srcAddr, dstAddr, reached.count(dstAddr) == 0, std::move(model) });
+        }
+    }
+    std::stable_sort(inputs.begin(), inputs.end(), [](const batch_input_t& a, const batch_input_t& b) {
+        return a.new_target && !b.new_target;
+    });
+    return inputs;
+}
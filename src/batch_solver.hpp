@@ -0,0 +1,38 @@
+//! \file
+/*
+**  Copyright (c) 2020 - Ponce
+**  Authors:
+**         Alberto Garcia Illera        agarciaillera@gmail.com
+**         Francisco Oca                francisco.oca.gonzalez@gmail.com
+**
+**  This program is under the terms of the BSD License.
+*/
+
+/*Generational search (like SAGE): solves the negation of every branch of the path constraints at once.
+It must not depend on IDA since it is shared with the offline tools*/
+
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+
+//Triton
+#include <triton/api.hpp>
+
+//Ponce
+#include "query_cache.hpp"
+#include "incremental_solver.hpp"
+
+//A new input taking a branch the execution did not take
+struct batch_input_t {
+    size_t path_constraint_index;
+    triton::uint64 srcAddr;
+    triton::uint64 dstAddr;
+    //The branch target was not reached anywhere in the current path, the input will cover new code
+    bool new_target;
+    std::unordered_map<triton::usize, triton::engines::solver::SolverModel> model;
+};
+
+//The solver of every worker joins the group while it runs, interrupting the group stops the queries being solved and the ones left
+std::vector<batch_input_t> solve_all_branches(triton::API& api, unsigned int threads, const triton::ast::SharedAbstractNode& extra_constraints = nullptr, QueryCache* cache = nullptr,
+    const solver_limits_t& limits = solver_limits_t(), SolverGroup* group = nullptr);
@@ -10,6 +10,8 @@
 
 #include <iostream>
 #include <fstream>
+#include <unordered_map>
+#include <unordered_set>
 
 // Ponce
 #include "blacklist.hpp"
@@ -17,6 +19,8 @@
 #include "callbacks.hpp"
 #include "utils.hpp"
 #include "triton_logic.hpp"
+#include "summaries.hpp"
+#include "instruction_cache.hpp"
 
 // IDA
 #include <ida.hpp>
@@ -112,6 +116,47 @@ std::vector<std::string> builtin_black_functions = {
     "CloseHandle",
 };
 
+//Names of the blacklist in use (the user one or the built in one) to look them up in constant time
+std::unordered_set<std::string> blacklisted_names;
+bool blacklisted_names_loaded = false;
+
+//The callee and verdict of every call site traced. It is cleared when the names or the segments can change
+struct call_site_t {
+    qstring callee;
+    //Summary of the callee, nullptr if it has none
+    const function_summary_t* summary;
+    bool blacklisted;
+};
+std::unordered_map<ea_t, call_site_t> call_sites;
+
+void clear_blacklist_cache()
+{
+    call_sites.clear();
+    blacklisted_names.clear();
+    blacklisted_names_loaded = false;
+}
+
+/*Returns the callee and verdict of the call at pc, resolving them the first time we see it*/
+static const call_site_t& get_call_site(ea_t pc)
+{
+    auto it = call_sites.find(pc);
+    if (it != call_sites.end())
+        return it->second;
+
+    if (!blacklisted_names_loaded) {
+        //Let's check if the user provided any blacklist file or we sholuld use the built in one
+        const std::vector<std::string>* to_use_blacklist = blacklkistedUserFunctions != nullptr ? blacklkistedUserFunctions : &builtin_black_functions;
+        blacklisted_names.insert(to_use_blacklist->begin(), to_use_blacklist->end());
+        blacklisted_names_loaded = true;
+    }
+
+    call_site_t call_site;
+    call_site.callee = get_callee_name(pc);
+    call_site.summary = find_summary(call_site.callee.c_str());
+    call_site.blacklisted = blacklisted_names.count(call_site.callee.c_str()) > 0;
+    return call_sites[pc] = call_site;
+}
+
 //Helper to concretize and untaint volatile registers
 void concretizeAndUntaintVolatileRegisters()
 {
@@ -128,6 +173,7 @@ void concretizeAndUntaintVolatileRegisters()
             if (strcmp(reg.getName().c_str(), volatile_regs[i]) == 0) {
                 api.concretizeRegister(reg);
                 api.untaintRegister(reg);
+                trace_recorder.recordConcretizeRegister(reg);
             }
         }
     }
@@ -142,6 +188,7 @@ void concretizeAndUntaintAllRegisters()
     for (auto it = regs.begin(); it != regs.end(); it++)
     {
         api.untaintRegister(it->second);
+        trace_recorder.recordConcretizeRegister(it->second);
     }
 }
 
@@ -163,57 +210,57 @@ void readBlacklistfile(char* path) {
             msg("[+] Adding %s to the blacklist funtion list\n", str.c_str());
         blacklkistedUserFunctions->push_back(str);
     }
+    clear_blacklist_cache();
+}
+
+
+void skip_call(ea_t pc, thid_t tid, std::function<void(ea_t)> on_return) {
+    /*We should set a BP in the next instruction right after the
+    call to enable tracing again*/
+    ea_t next_ea = next_head(pc, BADADDR);
+    add_bpt(next_ea, 1, BPT_EXEC);
+    //We set a comment so the user know why there is a new bp there
+    ponce_set_cmt(next_ea, "Temporal bp set by ponce for blacklisting\n", false);
+
+    breakpoint_pending_action bpa;
+    bpa.address = next_ea;
+    bpa.ignore_breakpoint = false;
+    bpa.callback = on_return; // We will enable back the trigger when this bp get's reached
+
+    //We add the action to the list
+    breakpoint_pending_actions.push_back(bpa);
+
+    //Disabling step tracing...
+    disable_step_trace();
+
+    //We want to tritonize the call, so the memory write for the ret address in the stack will be restore by the snapshot
+    tritonize(pc, tid);
+    ponce_runtime_status.runtimeTrigger.disable();
 }
 
 
 bool should_blacklist(ea_t pc, thid_t tid) {
-    insn_t cmd;
-    decode_insn(&cmd, pc);
+    const cached_instruction_t* inst = get_cached_instruction(pc);
+    if (inst == nullptr)
+        return false;
 
     // We do this to blacklist API that does not change the tainted input
-    if (cmd.itype == NN_call || cmd.itype == NN_callfi || cmd.itype == NN_callni)
+    if (inst->itype == NN_call || inst->itype == NN_callfi || inst->itype == NN_callni)
     {
-        //qstring callee = get_callee_name(pc);
-        qstring callee;
-        auto callee_lenght = get_func_name(&callee, pc);
-        std::vector<std::string>* to_use_blacklist;
-
-        //Let's check if the user provided any blacklist file or we sholuld use the built in one
-        if (blacklkistedUserFunctions != nullptr) {
-            to_use_blacklist = blacklkistedUserFunctions;
+        const call_site_t& call_site = get_call_site(pc);
+        //The functions with a summary are not blacklisted, their effects are applied to the symbolic state
+        if (call_site.summary)
+        {
+            summarize_call(call_site.summary, pc, tid);
+            return true;
         }
-        else {//We need to use the built in one
-            to_use_blacklist = &builtin_black_functions;
-        }
-
-        for (const auto& blacklisted_function : *to_use_blacklist) {
-            if (strcmp(callee.c_str(), blacklisted_function.c_str()) == 0)
-            {
-                //We are in a call to a blacklisted function.
-                /*We should set a BP in the next instruction right after the
-                blacklisted callback to enable tracing again*/
-                ea_t next_ea = next_head(pc, BADADDR);
-                add_bpt(next_ea, 1, BPT_EXEC);
-                //We set a comment so the user know why there is a new bp there
-                ponce_set_cmt(next_ea, "Temporal bp set by ponce for blacklisting\n", false);
-
-                breakpoint_pending_action bpa;
-                bpa.address = next_ea;
-                bpa.ignore_breakpoint = false;
-                bpa.callback = enableTrigger_and_concretize_registers; // We will enable back the trigger when this bp get's reached
-
-                //We add the action to the list
-                breakpoint_pending_actions.push_back(bpa);
-
-                //Disabling step tracing...
-                disable_step_trace();
-
-                //We want to tritonize the call, so the memory write for the ret address in the stack will be restore by the snapshot
-                tritonize(pc, tid);
-                ponce_runtime_status.runtimeTrigger.disable();
-
-                return true;
-            }
+        if (call_site.blacklisted)
+        {
+            //We are in a call to a blacklisted function.
+            if (cmdOptions.showExtraDebugInfo)
+                msg("[+] Call to blacklisted function %s at " MEM_FORMAT "\n", call_site.callee.c_str(), pc);
+            skip_call(pc, tid, enableTrigger_and_concretize_registers);
+            return true;
         }
     }
     return false;
@@ -9,6 +9,7 @@
 */
 
 #pragma once
+#include <functional>
 #include <vector>
 #include <string>
 #include <list>
@@ -24,10 +25,16 @@ typedef struct
     //If we found a previous breakpoint in the same address we should ignore it
     bool ignore_breakpoint;
     //This is the callback will be executed when this breakpoint is reached
-    void(*callback)(ea_t);
+    std::function<void(ea_t)> callback;
 } breakpoint_pending_action;
 
 extern std::list<breakpoint_pending_action> breakpoint_pending_actions;
 
+//Lets the call at pc run natively, on_return is called with the return address when it returns
+void skip_call(ea_t pc, thid_t tid, std::function<void(ea_t)> on_return);
 
-bool should_blacklist(ea_t pc, thid_t tid = 0);
\ No newline at end of file
+
+bool should_blacklist(ea_t pc, thid_t tid = 0);
+
+//Forgets the callees and verdicts of the call sites, to call when the names, the segments or the blacklist change
+void clear_blacklist_cache();
\ No newline at end of file
@@ -0,0 +1,78 @@
+//! \file
+/*
+**  Copyright (c) 2020 - Ponce
+**  Authors:
+**         Alberto Garcia Illera        agarciaillera@gmail.com
+**         Francisco Oca                francisco.oca.gonzalez@gmail.com
+**
+**  This program is under the terms of the BSD License.
+*/
+
+//Ponce
+#include "branch_index.hpp"
+#include "globals.hpp"
+
+#include <iterator>
+
+BranchIndex::BranchIndex() {
+    this->indexed = 0;
+}
+
+
+void BranchIndex::update(void) {
+    const auto& pathConstraints = api.getPathConstraints();
+    if (pathConstraints.size() < this->indexed)
+        this->invalidate();
+
+    for (; this->indexed < pathConstraints.size(); this->indexed++) {
+        // Every branch constraint of a path constraint comes from the same instruction
+        const auto& branchConstraints = pathConstraints[this->indexed].getBranchConstraints();
+        if (branchConstraints.empty())
+            continue;
+        ea_t srcAddr = (ea_t)std::get<1>(branchConstraints[0]);
+        this->branches[srcAddr].push_back(this->indexed);
+    }
+}
+
+
+const std::vector<size_t>* BranchIndex::getBranches(ea_t address) {
+    this->update();
+    auto it = this->branches.find(address);
+    return it == this->branches.end() ? nullptr : &it->second;
+}
+
+
+void BranchIndex::removeConstraint(size_t index, ea_t srcAddr) {
+    if (index >= this->indexed)
+        return;
+
+    auto& removed = this->branches[srcAddr];
+    auto it = std::find(removed.rbegin(), removed.rend(), index);
+    if (it == removed.rend()) {
+        this->invalidate();
+        return;
+    }
+    removed.erase(std::next(it).base());
+    this->indexed--;
+
+    // The path constraints after the removed one moved back one position
+    const auto& pathConstraints = api.getPathConstraints();
+    for (size_t i = index; i < this->indexed; i++) {
+        const auto& branchConstraints = pathConstraints[i].getBranchConstraints();
+        if (branchConstraints.empty())
+            continue;
+        auto& moved = this->branches[(ea_t)std::get<1>(branchConstraints[0])];
+        auto position = std::find(moved.rbegin(), moved.rend(), i + 1);
+        if (position == moved.rend()) {
+            this->invalidate();
+            return;
+        }
+        *position = i;
+    }
+}
+
+
+void BranchIndex::invalidate(void) {
+    this->branches.clear();
+    this->indexed = 0;
+}
@@ -0,0 +1,52 @@
+//! \file
+/*
+**  Copyright (c) 2020 - Ponce
+**  Authors:
+**         Alberto Garcia Illera        agarciaillera@gmail.com
+**         Francisco Oca                francisco.oca.gonzalez@gmail.com
+**
+**  This program is under the terms of the BSD License.
+*/
+
+/*Indexes of the path constraints by the address of their branch. The disassembly popup looks for the branches at the
+address clicked, going through all the path constraints every time was slow on long traces.
+The new path constraints are added as they are recorded. The code removing or replacing path constraints must call
+removeConstraint() or invalidate() so the index is built again the next time it is used*/
+
+#pragma once
+
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+//IDA
+#include <pro.h>
+
+//! \class BranchIndex
+//! \brief The path constraints of every branch address.
+class BranchIndex {
+
+private:
+    //! Indexes in the path constraints, in ascending order, by branch address.
+    std::unordered_map<ea_t, std::vector<size_t>> branches;
+
+    //! Number of path constraints indexed.
+    size_t indexed;
+
+public:
+    //! Constructor.
+    BranchIndex();
+
+    //! Indexes the path constraints added since the last update. The index is built again if some were removed.
+    void update(void);
+
+    //! Indexes of the path constraints of the branch at address, nullptr if there is none.
+    const std::vector<size_t>* getBranches(ea_t address);
+
+    //! Updates the index after the path constraint at index, of the branch at srcAddr, was erased. Only the path
+    //! constraints after it are moved so it is cheap near the end.
+    void removeConstraint(size_t index, ea_t srcAddr);
+
+    //! Forgets the index, to call after the path constraints are removed or replaced.
+    void invalidate(void);
+};
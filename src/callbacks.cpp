@@ -20,6 +20,10 @@
 #include "blacklist.hpp"
 #include "actions.hpp"
 #include "triton_logic.hpp"
+#include "instruction_cache.hpp"
+#include "memory_cache.hpp"
+#include "garbage_collector.hpp"
+#include "solver_job.hpp"
 
 //IDA
 #include <ida.hpp>
@@ -36,6 +40,12 @@ ssize_t idaapi tracer_callback(void* user_data, int notification_code, va_list v
 {
     //if (cmdOptions.showExtraDebugInfo)
     //    msg("[+] Notification code: %d str: %s\n", notification_code, notification_code_to_string(notification_code).c_str());
+    //Every debugger event means the process run (or could have run) since we read its memory
+    invalidate_memory_cache();
+    invalidate_register_cache();
+    //The comments and colors are buffered while stepping, the user sees them when the process stops
+    if (notification_code != dbg_trace)
+        flush_annotations();
     switch (notification_code)
     {
     case dbg_process_start:
@@ -46,6 +56,14 @@ ssize_t idaapi tracer_callback(void* user_data, int notification_code, va_list v
         triton_restart_engines();        
         break;
     }
+    case dbg_library_load:
+    case dbg_library_unload:
+    {
+        //The segments changed so the decoded instructions may not be valid anymore
+        clear_instruction_cache();
+        clear_blacklist_cache();
+        break;
+    }
     case dbg_step_into:
     case dbg_step_over:
     {
@@ -66,6 +84,8 @@ ssize_t idaapi tracer_callback(void* user_data, int notification_code, va_list v
         //Sometimes the cmd structure doesn't correspond with the traced instruction
         //With this we are filling cmd with the instruction at the address specified
 
+        //The blacklist and the summaries change the engine the solver job reads
+        stop_solver_job();
         if (should_blacklist(pc, tid)) {
             // We have blacklisted this call so we should not keep going 
             return 0;
@@ -82,6 +102,8 @@ ssize_t idaapi tracer_callback(void* user_data, int notification_code, va_list v
         if (cmdOptions.showDebugInfo && ponce_runtime_status.total_number_traced_ins % 1000 == 0)
             msg("Instructions traced: %d Symbolic instructions: %d Symbolic conditions: %d Time: %lld secs\n", ponce_runtime_status.total_number_traced_ins, ponce_runtime_status.total_number_symbolic_ins, ponce_runtime_status.total_number_symbolic_conditions, GetTimeMs64() - ponce_runtime_status.tracing_start_time);
         //msg("[+] Instructions traced: %d\n", ponce_runtime_status.total_number_traced_ins);
+        if (ponce_runtime_status.total_number_traced_ins % GC_CHECK_PERIOD == 0)
+            check_memory_budget();
 
         //This is the wow64 switching, we need to skip it. https://forum.hex-rays.com/viewtopic.php?f=8&t=4070
         if (ponce_runtime_status.last_triton_instruction->getDisassembly().find("call dword ptr fs:[0xc0]") != -1) {
@@ -100,6 +122,7 @@ ssize_t idaapi tracer_callback(void* user_data, int notification_code, va_list v
 
         //Check if the limit instructions limit was reached
         if (cmdOptions.limitInstructionsTracingMode && ponce_runtime_status.current_trace_counter >= cmdOptions.limitInstructionsTracingMode) {
+            flush_annotations();
             int answer = ask_yn(1, "[?] %u instructions has been traced. Do you want to execute %u more?", ponce_runtime_status.total_number_traced_ins, (unsigned int)cmdOptions.limitInstructionsTracingMode);
             if (answer == 0 || answer == -1)  { //No or Cancel
                 // stop the trace mode and suspend the process
@@ -119,6 +142,7 @@ ssize_t idaapi tracer_callback(void* user_data, int notification_code, va_list v
                 ponce_runtime_status.tracing_start_time = GetTimeMs64();
             }
             else if ((GetTimeMs64() - ponce_runtime_status.tracing_start_time) / 1000 >= cmdOptions.limitTime) {
+                flush_annotations();
                 int answer = ask_yn(1, "[?] the tracing was working for %u seconds(%u inst traced!). Do you want to execute it %u more?", (unsigned int)((GetTimeMs64() - ponce_runtime_status.tracing_start_time) / 1000), ponce_runtime_status.total_number_traced_ins, (unsigned int)cmdOptions.limitTime);
                 if (answer == 0 || answer == -1) { //No or Cancel
                     // stop the trace mode and suspend the process
@@ -195,6 +219,9 @@ ssize_t idaapi tracer_callback(void* user_data, int notification_code, va_list v
         //unhook_from_notification_point(HT_DBG, tracer_callback, NULL);
         ponce_runtime_status.runtimeTrigger.disable();
         enable_step_trace(false);
+        clear_instruction_cache();
+        clear_blacklist_cache();
+        trace_recorder.stop();
         //Removing snapshot if it exists
         if (snapshot.exists())
             snapshot.resetEngine();
@@ -313,15 +340,24 @@ ssize_t idaapi ui_callback(void* ud, int notification_code, va_list va)
         if (view_type == BWN_DISASM) {
             //&& !(is_debugger_on() && !ponce_runtime_status.runtimeTrigger.getState())) { // Don't let solve formulas if user is debugging natively 
 
-            for (const auto& pc : api.getPathConstraints()) {
-                auto temp = pc.getBranchConstraints();
-            }
-            /* For the selected address(cur_ea), let's count how many branches we can reach (how many non taken addresses are in reach)*/
-            int non_taken_branches_n = std::count_if(api.getPathConstraints().begin(), api.getPathConstraints().end(), [cur_ea](const auto& pc) {
-                for (auto const& [taken, srcAddr, dstAddr, pc] : pc.getBranchConstraints()) {
-                    if (cur_ea == srcAddr && !taken) return true;
+            const auto& pathConstraints = api.getPathConstraints();
+            static const std::vector<size_t> no_branches;
+            const std::vector<size_t>* branches = branch_index.getBranches(cur_ea);
+            if (!branches)
+                branches = &no_branches;
+
+            /* Returns the destination of the taken or non taken branch of a path constraint at the selected address, 0 if there is none*/
+            auto get_branch = [&](size_t path_constraint_index, bool taken_branch) -> triton::uint64 {
+                for (auto const& [taken, srcAddr, dstAddr, pc] : pathConstraints[path_constraint_index].getBranchConstraints()) {
+                    if (cur_ea == srcAddr && taken == taken_branch)
+                        return dstAddr;
                 }
-                return false;
+                return 0;
+            };
+
+            /* For the selected address(cur_ea), let's count how many branches we can reach (how many non taken addresses are in reach)*/
+            int non_taken_branches_n = (int)std::count_if(branches->begin(), branches->end(), [&](size_t path_constraint_index) {
+                return get_branch(path_constraint_index, false) != 0;
                 });
 
 
@@ -333,32 +369,28 @@ ssize_t idaapi ui_callback(void* ud, int notification_code, va_list va)
                 // There is only one non taken branch, no need to add submenus
                 // But we need to modify the Solve Formula menu with more info and the path constraint index
                 // The tooltip is not updated on the update event, we need to unregister the Solve formula submenu and add a new one
-                unsigned int path_constraint_index = 0;
-                for (const auto& pc : api.getPathConstraints()) {
-                    for (auto const& [taken, srcAddr, dstAddr, pc] : pc.getBranchConstraints()) {
-                        if (cur_ea == srcAddr && !taken) { // get the non taken branch for the path constraint the user clicked on          
-                            // Using the solve formula as template
-                            attach_action_solve(dstAddr, path_constraint_index, form, popup_handle, 0);
-                            break;
-                        }
+                for (size_t path_constraint_index : *branches) {
+                    // get the non taken branch for the path constraint the user clicked on
+                    if (triton::uint64 dstAddr = get_branch(path_constraint_index, false)) {
+                        // Using the solve formula as template
+                        attach_action_solve(dstAddr, (unsigned int)path_constraint_index, form, popup_handle, 0);
                     }
-                    path_constraint_index++;
                 }
             }
             else {
                 // There are more than one non taken branches, we add submenus
                 // Fix https://github.com/illera88/Ponce/issues/116
-                if (non_taken_branches_n <= 5) {
-                    unsigned int path_constraint_index = 0;
-                    for (const auto& pc : api.getPathConstraints()) {
-                        for (auto const& [taken, srcAddr, dstAddr, pc] : pc.getBranchConstraints()) {
-                            if (cur_ea == srcAddr && taken) { // get the taken branch for the path constraint the user clicked on          
-                                // Using the solve formula as template (If not we modify the name of the main solve formula menu)
-                                attach_action_solve(dstAddr, path_constraint_index, form, popup_handle, 1);    
-                                break;
-                            }
-                        }
-                        path_constraint_index++;
+                std::vector<std::pair<size_t, triton::uint64>> taken_branches;
+                for (size_t path_constraint_index : *branches) {
+                    // get the taken branch for the path constraint the user clicked on
+                    if (triton::uint64 dstAddr = get_branch(path_constraint_index, true))
+                        taken_branches.push_back({ path_constraint_index, dstAddr });
+                }
+
+                if (taken_branches.size() <= 5) {
+                    for (const auto& [path_constraint_index, dstAddr] : taken_branches) {
+                        // Using the solve formula as template (If not we modify the name of the main solve formula menu)
+                        attach_action_solve(dstAddr, (unsigned int)path_constraint_index, form, popup_handle, 1);
                     }
                 }
                 else {
@@ -366,50 +398,14 @@ ssize_t idaapi ui_callback(void* ud, int notification_code, va_list va)
                         - The first two
                         - An option to select an arbitrary hit
                         - The last two*/
-                    unsigned int path_constraint_index = 0;
-                    unsigned int count = 0;
-                    // Show the first two
-                    for (const auto& pc : api.getPathConstraints()) {
-                        for (auto const& [taken, srcAddr, dstAddr, pc] : pc.getBranchConstraints()) {
-                            if (cur_ea == srcAddr && taken) { // get the taken branch for the path constraint the user clicked on          
-                                if (count == 2) // Only adding the first two
-                                    break;
-                                // Using the solve formula as template (If not we modify the name of the main solve formula menu)
-                                attach_action_solve(dstAddr, path_constraint_index, form, popup_handle, 1);
-                                count++;
-                                break;
-                            }
-                        }
-                        path_constraint_index++;
-                    }
+                    for (size_t i = 0; i < 2; i++)
+                        attach_action_solve(taken_branches[i].second, (unsigned int)taken_branches[i].first, form, popup_handle, 1);
 
                     // Option to select an arbitrary hit
                     attach_action_solve(NULL, 0, form, popup_handle, 2);
 
-                    path_constraint_index = non_taken_branches_n;
-                    count = 0;
-                    struct pair_address_index {
-                        unsigned int index;
-                        triton::uint64 dstAddr;
-                    };
-                    struct pair_address_index holder[2] = {0};
-                    // Show the last two
-                    for (auto rit = std::rbegin(api.getPathConstraints()); rit != std::rend(api.getPathConstraints()); ++rit) {
-                        for (auto const& [taken, srcAddr, dstAddr, pc] : rit->getBranchConstraints()) {
-                            if (cur_ea == srcAddr && taken) { // get the taken branch for the path constraint the user clicked on          
-                                if (count == 2) // Only adding the first two
-                                    break;
-                                // Using the solve formula as template (If not we modify the name of the main solve formula menu)
-                                // Keep in holder the last two items so we add them ad the en in asc order
-                                holder[count] = { path_constraint_index, dstAddr };
-                                count++;
-                                break;
-                            }
-                        }
-                        path_constraint_index--;
-                    }
-                    attach_action_solve(holder[1].dstAddr, holder[1].index, form, popup_handle, 1);
-                    attach_action_solve(holder[0].dstAddr, holder[0].index, form, popup_handle, 1);
+                    for (size_t i = taken_branches.size() - 2; i < taken_branches.size(); i++)
+                        attach_action_solve(taken_branches[i].second, (unsigned int)taken_branches[i].first, form, popup_handle, 1);
                 }
             }
         }
@@ -425,4 +421,26 @@ ssize_t idaapi ui_callback(void* ud, int notification_code, va_list va)
     return 0;
 }
 
-
+ssize_t idaapi idb_callback(void* ud, int notification_code, va_list va)
+{
+    switch (notification_code)
+    {
+    //The callees of the call sites are resolved by name
+    case idb_event::renamed:
+    //The addresses of the call sites changed
+    case idb_event::allsegs_moved:
+    {
+        clear_blacklist_cache();
+        break;
+    }
+    //The user patched the code, the instructions overlapping the byte are decoded again
+    case idb_event::byte_patched:
+    {
+        ea_t ea = va_arg(va, ea_t);
+        invalidate_instruction_cache(ea, 1);
+        invalidate_memory_cache();
+        break;
+    }
+    }
+    return 0;
+}
@@ -8,8 +8,10 @@
 **  This program is under the terms of the BSD License.
 */
 
+#include <algorithm>
 #include <cstring>
 #include <stdexcept>
+#include <vector>
 
 //Triton
 #include <triton/cpuSize.hpp>
@@ -19,6 +21,7 @@
 
 #include "context.hpp"
 #include "globals.hpp"
+#include "memory_cache.hpp"
 
 //IDA
 #include <dbg.hpp>
@@ -35,10 +38,7 @@ triton::uint512 IDA_getCurrentMemoryValue(ea_t addr, triton::uint32 size)
         return -1;
     }
     triton::uint8 buffer[64] = { 0 };
-    //This is the way to force IDA to read the value from the debugger
-    //More info here: https://www.hex-rays.com/products/ida/support/sdkdoc/dbg_8hpp.html#ac67a564945a2c1721691aa2f657a908c
-    invalidate_dbgmem_contents(addr, size);
-    get_bytes(&buffer, size, addr, GMB_READALL, NULL);
+    ponce_get_bytes(&buffer, size, addr);
 
     triton::uint512 value = 0;
     switch (size) {
@@ -60,6 +60,7 @@ void needConcreteMemoryValue_cb(triton::API& api, const triton::arch::MemoryAcce
 {
     bool had_it = false;
     auto IDA_memValue = IDA_getCurrentMemoryValue((ea_t)mem.getAddress(), mem.getSize());
+    trace_recorder.recordMemoryValue((ea_t)mem.getAddress(), mem.getSize(), IDA_memValue);
 
     if (api.isConcreteMemoryValueDefined(mem)) {
         auto triton_memValue = api.getConcreteMemoryValue(mem, false);
@@ -88,26 +89,118 @@ void needConcreteMemoryValue_cb(triton::API& api, const triton::arch::MemoryAcce
     }
 }
 
-/* Get a reg value from IDA debugger*/
-triton::uint512 IDA_getCurrentRegisterValue(const triton::arch::Register& reg)
+//Parent register values read from the debugger since the last debugger event, indexed by the Triton register id
+std::vector<triton::uint512> register_cache;
+std::vector<bool> register_cache_valid;
+//IDA only needs to be asked once per debugger event to refresh its registers
+bool registers_need_refresh = true;
+
+/*The registers can change every time the process runs or Ponce writes them.
+This is called on every debugger event and after every set_reg_val*/
+void invalidate_register_cache()
+{
+    std::fill(register_cache_valid.begin(), register_cache_valid.end(), false);
+    registers_need_refresh = true;
+}
+
+/*Returns the value of a parent register (rax, eflags, xmm0...) reading it from IDA only the first time since the last debugger event.
+After invalidating the registers, the first get_reg_val makes IDA fetch the whole register file from the debugger
+and the following ones are served from IDA's own copy*/
+static triton::uint512 get_parent_register_value(const triton::arch::Register& parent)
 {
+    auto id = (size_t)parent.getId();
+    if (id >= register_cache.size()) {
+        register_cache.resize(id + 1);
+        register_cache_valid.resize(id + 1, false);
+    }
+    if (register_cache_valid[id])
+        return register_cache[id];
+
+    if (registers_need_refresh) {
+        //We need to invalidate the registers. If not IDA uses the last value when program was stopped
+        invalidate_dbg_state(DBGINV_REGS);
+        registers_need_refresh = false;
+    }
+
+    //IDA calls eflags EFL
+    std::string reg_name = parent.getId() == api.registers.x86_eflags.getId() ? "EFL" : parent.getName();
+    assert(!reg_name.empty());
     regval_t reg_value;
     triton::uint512 value = 0;
-    auto reg_name = reg.getName();
-    assert(!reg_name.empty());
-    //We need to invalidate the registers. If not IDA uses the last value when program was stopped
-    invalidate_dbg_state(DBGINV_REGS);
-    get_reg_val(reg_name.c_str(), &reg_value);
-    value = reg_value.ival;
-    /* Sync with the libTriton */
-    triton::arch::Register syncReg;
-    if (reg.getId() >= api.registers.x86_af.getId() && reg.getId() <= api.registers.x86_zf.getId())
-        syncReg = api.registers.x86_eflags;
-    else if (reg.getId() >= api.registers.x86_ie.getId() && reg.getId() <= api.registers.x86_fz.getId())
-        syncReg = api.registers.x86_mxcsr;
-    else
-        syncReg = api.getRegister(reg.getParent());
+    if (get_reg_val(reg_name.c_str(), &reg_value)) {
+        if (reg_value.rvtype == RVT_INT) {
+            value = reg_value.ival;
+        }
+        else if (reg_value.rvtype >= 0) {
+            //SIMD registers are given as raw bytes
+            const bytevec_t& bytes = reg_value.bytes();
+            for (size_t i = qmin(bytes.size(), (size_t)triton::size::max_supported); i > 0; i--)
+                value = (value << 8) | bytes[i - 1];
+        }
+    }
+
+    register_cache[id] = value;
+    register_cache_valid[id] = true;
+    return value;
+}
+
+/*Returns the bit of eflags for a x86 flag, or -1 if reg is not an eflags flag*/
+static int get_eflags_bit(const triton::arch::Register& reg)
+{
+    auto id = reg.getId();
+    if (id == api.registers.x86_cf.getId()) return 0;
+    if (id == api.registers.x86_pf.getId()) return 2;
+    if (id == api.registers.x86_af.getId()) return 4;
+    if (id == api.registers.x86_zf.getId()) return 6;
+    if (id == api.registers.x86_sf.getId()) return 7;
+    if (id == api.registers.x86_tf.getId()) return 8;
+    if (id == api.registers.x86_if.getId()) return 9;
+    if (id == api.registers.x86_df.getId()) return 10;
+    if (id == api.registers.x86_of.getId()) return 11;
+    return -1;
+}
+
+/*Returns the first bit of mxcsr for a x86 mxcsr field, or -1 if reg is not a mxcsr field*/
+static int get_mxcsr_bit(const triton::arch::Register& reg)
+{
+    auto id = reg.getId();
+    if (id == api.registers.x86_ie.getId()) return 0;
+    if (id == api.registers.x86_de.getId()) return 1;
+    if (id == api.registers.x86_ze.getId()) return 2;
+    if (id == api.registers.x86_oe.getId()) return 3;
+    if (id == api.registers.x86_ue.getId()) return 4;
+    if (id == api.registers.x86_pe.getId()) return 5;
+    if (id == api.registers.x86_daz.getId()) return 6;
+    if (id == api.registers.x86_im.getId()) return 7;
+    if (id == api.registers.x86_dm.getId()) return 8;
+    if (id == api.registers.x86_zm.getId()) return 9;
+    if (id == api.registers.x86_om.getId()) return 10;
+    if (id == api.registers.x86_um.getId()) return 11;
+    if (id == api.registers.x86_pm.getId()) return 12;
+    if (id == api.registers.x86_rl.getId()) return 13;
+    if (id == api.registers.x86_rh.getId()) return 14;
+    if (id == api.registers.x86_fz.getId()) return 15;
+    return -1;
+}
+
+/* Get a reg value from IDA debugger*/
+triton::uint512 IDA_getCurrentRegisterValue(const triton::arch::Register& reg)
+{
+    /* Sync with the libTriton. Triton keeps the x86 flags as independent registers but the debugger
+    gives us eflags and mxcsr, the same way it gives us rax and not al*/
+    if (api.getArchitecture() == triton::arch::ARCH_X86 || api.getArchitecture() == triton::arch::ARCH_X86_64) {
+        int bit = get_eflags_bit(reg);
+        if (bit >= 0)
+            return (get_parent_register_value(api.registers.x86_eflags) >> bit) & 1;
+        bit = get_mxcsr_bit(reg);
+        if (bit >= 0)
+            return (get_parent_register_value(api.registers.x86_mxcsr) >> bit) & 1;
+    }
 
+    const triton::arch::Register& parent = api.getRegister(reg.getParent());
+    triton::uint512 value = get_parent_register_value(parent);
+    if (reg.getId() != parent.getId())
+        value = (value >> reg.getLow()) & ((triton::uint512(1) << reg.getBitSize()) - 1);
     return value;
 }
 
@@ -116,6 +209,7 @@ void needConcreteRegisterValue_cb(triton::API& api, const triton::arch::Register
 {
     bool had_it = true;
     auto IDA_regValue = IDA_getCurrentRegisterValue(reg);
+    trace_recorder.recordRegisterValue(reg, IDA_regValue);
     auto triton_regValue = api.getConcreteRegisterValue(reg, false);
 
     if (IDA_regValue != triton_regValue) {
@@ -17,4 +17,5 @@
 void needConcreteMemoryValue_cb(triton::API& api, const triton::arch::MemoryAccess& mem);
 void needConcreteRegisterValue_cb(triton::API& api, const triton::arch::Register& reg);
 triton::uint512 IDA_getCurrentMemoryValue(ea_t addr, triton::uint32 size);
-triton::uint512 IDA_getCurrentRegisterValue(const triton::arch::Register& reg);
\ No newline at end of file
+triton::uint512 IDA_getCurrentRegisterValue(const triton::arch::Register& reg);
+void invalidate_register_cache();
@@ -0,0 +1,216 @@
+//! \file
+/*
+**  Copyright (c) 2020 - Ponce
+**  Authors:
+**         Alberto Garcia Illera        agarciaillera@gmail.com
+**         Francisco Oca                francisco.oca.gonzalez@gmail.com
+**
+**  This program is under the terms of the BSD License.
+*/
+
+#include <algorithm>
+#include <vector>
+
+#include "engine_edits.hpp"
+
+static bool is_range_symbolized(triton::API& api, triton::uint64 address, triton::uint64 size)
+{
+    for (triton::uint64 i = 0; i < size; i++) {
+        if (api.isMemorySymbolized(address + i))
+            return true;
+    }
+    return false;
+}
+
+static bool is_range_tainted(triton::API& api, triton::uint64 address, triton::uint64 size)
+{
+    for (triton::uint64 i = 0; i < size; i++) {
+        if (api.isMemoryTainted(address + i))
+            return true;
+    }
+    return false;
+}
+
+static void concretize_and_untaint_range(triton::API& api, triton::uint64 address, triton::uint64 size)
+{
+    if (size <= SUMMARY_MAX_BYTES) {
+        for (triton::uint64 i = 0; i < size; i++) {
+            api.concretizeMemory(address + i);
+            api.untaintMemory(address + i);
+        }
+        return;
+    }
+    //Big buffers are cheaper to clean from the symbolic and tainted cells
+    std::vector<triton::uint64> cells;
+    for (const auto& [cell, expression] : api.getSymbolicMemory()) {
+        if (cell >= address && cell - address < size)
+            cells.push_back(cell);
+    }
+    for (auto cell : cells)
+        api.concretizeMemory(cell);
+    for (auto cell : api.getTaintedMemory()) {
+        if (cell >= address && cell - address < size)
+            api.untaintMemory(cell);
+    }
+}
+
+static void set_return_value(triton::API& api, const summary_effect_t& effect, const triton::ast::SharedAbstractNode& node, bool tainted)
+{
+    const auto& reg = api.getRegister((triton::arch::register_e)effect.register_id);
+    auto expression = api.newSymbolicExpression(node, effect.name + " summary");
+    api.assignSymbolicExpressionToRegister(expression, reg);
+    if (tainted)
+        api.taintRegister(reg);
+}
+
+static void set_memory_byte(triton::API& api, const summary_effect_t& effect, triton::uint64 address, const triton::ast::SharedAbstractNode& node, bool tainted)
+{
+    if (node) {
+        auto expression = api.newSymbolicExpression(node, effect.name + " summary");
+        api.assignSymbolicExpressionToMemory(expression, triton::arch::MemoryAccess(address, 1));
+    }
+    else {
+        api.concretizeMemory(address);
+    }
+    if (tainted)
+        api.taintMemory(address);
+    else
+        api.untaintMemory(address);
+}
+
+/*The length is the index of the first null byte: ite(s[0] == 0, 0, ite(s[1] == 0, 1, ... length))*/
+static void apply_length(triton::API& api, const summary_effect_t& effect)
+{
+    bool tainted = is_range_tainted(api, effect.buffer, effect.bytes);
+    if (!tainted && !is_range_symbolized(api, effect.buffer, effect.bytes))
+        return;
+
+    const auto& ast = api.getAstContext();
+    auto bits = api.getRegister((triton::arch::register_e)effect.register_id).getBitSize();
+    auto node = ast->bv(effect.result, bits);
+    for (triton::uint64 i = effect.result; i-- > 0;) {
+        auto byte = api.getMemoryAst(triton::arch::MemoryAccess(effect.buffer + i, 1));
+        node = ast->ite(ast->equal(byte, ast->bv(0, 8)), ast->bv(i, bits), node);
+    }
+    set_return_value(api, effect, node, tainted);
+}
+
+/*The result comes from the first different byte. The chain goes until the end of the shortest string, not only until
+the first difference, so the solver can make both buffers equal in one query*/
+static void apply_compare(triton::API& api, const summary_effect_t& effect)
+{
+    bool tainted = is_range_tainted(api, effect.buffer, effect.bytes) || is_range_tainted(api, effect.source, effect.bytes);
+    if (!tainted && !is_range_symbolized(api, effect.buffer, effect.bytes) && !is_range_symbolized(api, effect.source, effect.bytes))
+        return;
+
+    //Some implementations return -1, 0 or 1 and others the difference of the bytes, the expression must evaluate to the concrete result
+    auto concrete = (triton::sint32)(triton::uint32)effect.result;
+    bool sign_only = concrete >= -1 && concrete <= 1;
+
+    const auto& ast = api.getAstContext();
+    auto zero = ast->bv(0, 32);
+    auto node = zero;
+    for (triton::uint64 i = effect.bytes; i-- > 0;) {
+        auto a = api.getMemoryAst(triton::arch::MemoryAccess(effect.buffer + i, 1));
+        auto b = api.getMemoryAst(triton::arch::MemoryAccess(effect.source + i, 1));
+        auto difference = sign_only ? ast->ite(ast->bvult(a, b), ast->bv(0xffffffff, 32), ast->bv(1, 32)) : ast->bvsub(ast->zx(24, a), ast->zx(24, b));
+        auto next = effect.string ? ast->ite(ast->equal(a, ast->bv(0, 8)), zero, node) : node;
+        node = ast->ite(ast->distinct(a, b), difference, next);
+    }
+    //The int result is written to eax, that clears the upper half of rax
+    auto bits = api.getRegister((triton::arch::register_e)effect.register_id).getBitSize();
+    if (bits > 32)
+        node = ast->zx(bits - 32, node);
+    set_return_value(api, effect, node, tainted);
+}
+
+/*Nothing was processed since the call, the source still has the expressions it had before it. They are all taken
+before writing the buffer since both can overlap (memmove)*/
+static void apply_copy(triton::API& api, const summary_effect_t& effect)
+{
+    std::vector<triton::ast::SharedAbstractNode> expressions;
+    std::vector<bool> tainted;
+    for (triton::uint64 i = 0; i < effect.bytes; i++) {
+        triton::uint64 address = effect.source + i;
+        expressions.push_back(api.isMemorySymbolized(address) ? api.getMemoryAst(triton::arch::MemoryAccess(address, 1)) : nullptr);
+        tainted.push_back(api.isMemoryTainted(address));
+    }
+    for (triton::uint64 i = 0; i < effect.bytes; i++)
+        set_memory_byte(api, effect, effect.buffer + i, expressions[i], tainted[i]);
+    concretize_and_untaint_range(api, effect.buffer + effect.bytes, effect.padding);
+}
+
+static void apply_fill(triton::API& api, const summary_effect_t& effect)
+{
+    triton::ast::SharedAbstractNode value;
+    bool tainted;
+    if (effect.register_id != triton::arch::ID_REG_INVALID) {
+        const auto& reg = api.getRegister((triton::arch::register_e)effect.register_id);
+        tainted = api.isRegisterTainted(reg);
+        value = api.isRegisterSymbolized(reg) ? api.getRegisterAst(reg) : nullptr;
+    }
+    else {
+        auto argument = triton::arch::MemoryAccess(effect.source, api.getGprSize());
+        tainted = api.isMemoryTainted(argument);
+        value = api.isMemorySymbolized(argument) ? api.getMemoryAst(argument) : nullptr;
+    }
+
+    if (!value && !tainted) {
+        concretize_and_untaint_range(api, effect.buffer, effect.bytes);
+        return;
+    }
+    const auto& ast = api.getAstContext();
+    for (triton::uint64 i = 0; i < effect.bytes; i++)
+        set_memory_byte(api, effect, effect.buffer + i, value ? ast->extract(7, 0, value) : nullptr, tainted);
+}
+
+void apply_summary_effect(triton::API& api, const summary_effect_t& effect)
+{
+    switch (effect.kind) {
+    case SUMMARY_EFFECT_LENGTH:
+        apply_length(api, effect);
+        break;
+    case SUMMARY_EFFECT_COMPARE:
+        apply_compare(api, effect);
+        break;
+    case SUMMARY_EFFECT_COPY:
+        apply_copy(api, effect);
+        break;
+    case SUMMARY_EFFECT_FILL:
+        apply_fill(api, effect);
+        break;
+    case SUMMARY_EFFECT_CONCRETIZE:
+        concretize_and_untaint_range(api, effect.buffer, effect.bytes);
+        break;
+    default:
+        break;
+    }
+}
+
+/*A copy of the path manager of the symbolic engine we can edit. It is put back with the public assignment of the PathManager*/
+class path_constraints_editor : public triton::engines::symbolic::PathManager {
+public:
+    path_constraints_editor(const triton::engines::symbolic::PathManager& other) : triton::engines::symbolic::PathManager(other) {}
+
+    void erase(size_t first, size_t count) {
+        this->pathConstraints.erase(this->pathConstraints.begin() + first, this->pathConstraints.begin() + first + count);
+    }
+};
+
+void erase_path_constraints(triton::API& api, size_t first, size_t count)
+{
+    size_t size = api.getPathConstraints().size();
+    if (first >= size || count == 0)
+        return;
+    count = std::min(count, size - first);
+
+    //The API can only pop the last path constraint
+    if (first + count == size) {
+        for (size_t i = 0; i < count; i++)
+            api.popPathConstraint();
+        return;
+    }
+    path_constraints_editor editor(*api.getSymbolicEngine());
+    editor.erase(first, count);
+    static_cast<triton::engines::symbolic::PathManager&>(*api.getSymbolicEngine()) = editor;
+}
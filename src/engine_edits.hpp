@@ -0,0 +1,63 @@
+//! \file
+/*
+**  Copyright (c) 2020 - Ponce
+**  Authors:
+**         Alberto Garcia Illera        agarciaillera@gmail.com
+**         Francisco Oca                francisco.oca.gonzalez@gmail.com
+**
+**  This program is under the terms of the BSD License.
+*/
+
+/*The changes Ponce does to the Triton engines besides processing the instructions: the effects of the summarized
+calls and the removal of path constraints. They are recorded in the traces so ponce-replay does them too.
+It must not depend on IDA since it is shared with the offline tools*/
+
+#pragma once
+
+#include <string>
+
+//Triton
+#include <triton/api.hpp>
+
+//Bytes a summary follows. Bigger buffers are concretized like a blacklisted function would do
+#define SUMMARY_MAX_BYTES 0x1000
+
+enum summary_effect_e {
+    //The result register gets the index of the first null byte of the buffer
+    SUMMARY_EFFECT_LENGTH = 1,
+    //The result register gets the comparison of the buffer and the source
+    SUMMARY_EFFECT_COMPARE = 2,
+    //The buffer gets the expressions and the taint of the source, the padding after it is concretized
+    SUMMARY_EFFECT_COPY = 3,
+    //The buffer gets the low byte of the fill value, read from the register or from the stack at source
+    SUMMARY_EFFECT_FILL = 4,
+    //The buffer is concretized and untainted
+    SUMMARY_EFFECT_CONCRETIZE = 5,
+};
+
+//The effect of a summarized call once its concrete arguments and result are known
+struct summary_effect_t {
+    triton::uint8 kind = 0;
+    //Destination, string or first buffer
+    triton::uint64 buffer = 0;
+    //Source or second buffer. Address of the fill value when it is passed in the stack
+    triton::uint64 source = 0;
+    //Bytes of the buffer followed
+    triton::uint64 bytes = 0;
+    //Bytes after the copied ones concretized (strncpy pads with zeros)
+    triton::uint64 padding = 0;
+    //Concrete result of the call for lengths and comparisons
+    triton::uint64 result = 0;
+    //Register getting the result or holding the fill value, 0 (ID_REG_INVALID) if the fill value is in the stack
+    triton::uint32 register_id = 0;
+    //The compared buffers end at the first null byte
+    bool string = false;
+    //Summarized function, for the comments of the expressions
+    std::string name;
+};
+
+//Applies a summary effect to the symbolic and taint state. The result is written after the volatile registers are concretized
+void apply_summary_effect(triton::API& api, const summary_effect_t& effect);
+
+//Removes count path constraints starting at first, also in the middle of the path. Nothing must be solving meanwhile
+void erase_path_constraints(triton::API& api, size_t first, size_t count);
@@ -32,6 +32,7 @@ int idaapi modcb(int fid, form_actions_t& fa)
         fa.enable_field(9, isActivated ? 1 : 0);
         fa.enable_field(12, isActivated ? 1 : 0);
         fa.enable_field(13, isActivated ? 1 : 0);
+        fa.enable_field(30, isActivated ? 1 : 0);
         fa.enable_field(14, !isActivated ? 1 : 0); // TAINT_THROUGH_POINTERS only when tainting engine
         break;
     case -2:
@@ -43,6 +44,7 @@ int idaapi modcb(int fid, form_actions_t& fa)
         fa.enable_field(9, isActivated ? 1 : 0);
         fa.enable_field(12, isActivated ? 1 : 0);
         fa.enable_field(13, isActivated ? 1 : 0);
+        fa.enable_field(30, isActivated ? 1 : 0);
         fa.enable_field(14, !isActivated ? 1 : 0); // TAINT_THROUGH_POINTERS only when tainting engine
         break;
     case 5:
@@ -72,7 +74,7 @@ If you want to create a new checkbox you should:
 - add it to the msg at the end of the function for debug purposes*/
 void prompt_conf_window(void) {
     /*We should create as many ushort variables as groups of checkboxes we have in the form window*/
-    ushort chkgroup1, chkgroup2, chkgroup3;
+    ushort chkgroup1, chkgroup2, chkgroup3, chkgroup4;
     ushort symbolic_or_taint_engine = 0;
 
     if (!cmdOptions.already_configured) {
@@ -80,6 +82,7 @@ void prompt_conf_window(void) {
         chkgroup1 = 1;
         chkgroup2 = 0;
         chkgroup3 = 1 | 2;
+        chkgroup4 = 0;
 
         cmdOptions.blacklist_path[0] = '\0'; // Will use this to check if the user set some path for the blacklist
     }
@@ -89,8 +92,9 @@ void prompt_conf_window(void) {
         don't do this the variables will be always initialized to  the previous lines
         NOTE: Parenthesis are mandatory or it won't work!*/
         chkgroup1 = (cmdOptions.showDebugInfo ? 1 : 0) | (cmdOptions.showExtraDebugInfo ? 2 : 0);
-        chkgroup2 = (cmdOptions.CONCRETIZE_UNDEFINED_REGISTERS ? 1 : 0) | (cmdOptions.CONSTANT_FOLDING ? 2 : 0) | (cmdOptions.SYMBOLIZE_INDEX_ROTATION ? 4 : 0) | (cmdOptions.AST_OPTIMIZATIONS ? 8 : 0) | (cmdOptions.TAINT_THROUGH_POINTERS ? 16 : 0);
+        chkgroup2 = (cmdOptions.CONCRETIZE_UNDEFINED_REGISTERS ? 1 : 0) | (cmdOptions.CONSTANT_FOLDING ? 2 : 0) | (cmdOptions.SYMBOLIZE_INDEX_ROTATION ? 4 : 0) | (cmdOptions.AST_OPTIMIZATIONS ? 8 : 0) | (cmdOptions.TAINT_THROUGH_POINTERS ? 16 : 0) | (cmdOptions.summarizeLoops ? 32 : 0);
         chkgroup3 = (cmdOptions.addCommentsControlledOperands ? 1 : 0) | (cmdOptions.RenameTaintedFunctionNames ? 2 : 0) | (cmdOptions.addCommentsSymbolicExpresions ? 4 : 0);
+        chkgroup4 = (cmdOptions.cacheSolverResultsOnDisk ? 1 : 0) | (cmdOptions.solverPortfolio ? 2 : 0) | (cmdOptions.exportSolverQueries ? 4 : 0);
 
         symbolic_or_taint_engine = cmdOptions.use_symbolic_engine ? 0 : 1;
     }
@@ -100,8 +104,13 @@ void prompt_conf_window(void) {
         &chkgroup1,
         &chkgroup2,
         &chkgroup3,
+        &chkgroup4,
         &cmdOptions.limitTime,
         &cmdOptions.limitInstructionsTracingMode,
+        &cmdOptions.solverTimeout,
+        &cmdOptions.solverMemoryLimit,
+        &cmdOptions.memoryBudget,
+        &cmdOptions.pathConstraintsWindow,
         &cmdOptions.color_tainted,
         &cmdOptions.color_executed_instruction,
         &cmdOptions.color_tainted_condition,
@@ -133,6 +142,7 @@ void prompt_conf_window(void) {
         cmdOptions.SYMBOLIZE_INDEX_ROTATION = chkgroup2 & 4 ? 1 : 0;
         cmdOptions.AST_OPTIMIZATIONS = chkgroup2 & 8 ? 1 : 0;
         cmdOptions.TAINT_THROUGH_POINTERS = chkgroup2 & 16 ? 1 : 0;
+        cmdOptions.summarizeLoops = chkgroup2 & 32 ? 1 : 0;
         
         // Make sure that modes are correctly set since some engines
         // can't have some modes activated
@@ -144,12 +154,17 @@ void prompt_conf_window(void) {
             cmdOptions.CONSTANT_FOLDING = false;
             cmdOptions.SYMBOLIZE_INDEX_ROTATION = false;
             cmdOptions.AST_OPTIMIZATIONS = false;
+            cmdOptions.summarizeLoops = false;
         }
 
         cmdOptions.addCommentsControlledOperands = chkgroup3 & 1 ? 1 : 0;
         cmdOptions.RenameTaintedFunctionNames = chkgroup3 & 2 ? 1 : 0;
         cmdOptions.addCommentsSymbolicExpresions = chkgroup3 & 4 ? 1 : 0;
 
+        cmdOptions.cacheSolverResultsOnDisk = chkgroup4 & 1 ? 1 : 0;
+        cmdOptions.solverPortfolio = chkgroup4 & 2 ? 1 : 0;
+        cmdOptions.exportSolverQueries = chkgroup4 & 4 ? 1 : 0;
+
         if (cmdOptions.blacklist_path[0] != '\0') {
             //Means that the user set a path for custom blacklisted functions
             if (blacklkistedUserFunctions != NULL) {
@@ -167,6 +182,10 @@ void prompt_conf_window(void) {
             msg("\n"
                 "limitTime: %lld\n"
                 "limitInstructionsTracingMode: %lld\n"
+                "solverTimeout: %lld\n"
+                "solverMemoryLimit: %lld\n"
+                "memoryBudget: %lld\n"
+                "pathConstraintsWindow: %lld\n"
                 "use_symbolic_engine: %s\n"
                 "showDebugInfo: %s\n"
                 "showExtraDebugInfo: %s\n"
@@ -175,14 +194,22 @@ void prompt_conf_window(void) {
                 "SYMBOLIZE_INDEX_ROTATION: %s\n"
                 "AST_OPTIMIZATIONS: %s\n"
                 "TAINT_THROUGH_POINTERS: %s\n"
+                "summarizeLoops: %s\n"
                 "addCommentsControlledOperands: %s\n"
                 "RenameTaintedFunctionNames: %s\n"
                 "addCommentssymbolizexpresions: %s\n"
+                "cacheSolverResultsOnDisk: %s\n"
+                "solverPortfolio: %s\n"
+                "exportSolverQueries: %s\n"
                 "color_tainted: %x\n"
                 "color_tainted_execution: %x\n"
                 "color_tainted_condition: %x\n",
                 cmdOptions.limitTime,
                 cmdOptions.limitInstructionsTracingMode,
+                cmdOptions.solverTimeout,
+                cmdOptions.solverMemoryLimit,
+                cmdOptions.memoryBudget,
+                cmdOptions.pathConstraintsWindow,
                 cmdOptions.use_symbolic_engine ? "symbolic engine enabled" : "tainting engine enabled",
                 cmdOptions.showDebugInfo ? "true" : "false",
                 cmdOptions.showExtraDebugInfo ? "true" : "false",
@@ -191,9 +218,13 @@ void prompt_conf_window(void) {
                 cmdOptions.SYMBOLIZE_INDEX_ROTATION ? "true" : "false",
                 cmdOptions.AST_OPTIMIZATIONS ? "true" : "false",
                 cmdOptions.TAINT_THROUGH_POINTERS ? "true" : "false",
+                cmdOptions.summarizeLoops ? "true" : "false",
                 cmdOptions.addCommentsControlledOperands ? "true" : "false",
                 cmdOptions.RenameTaintedFunctionNames ? "true" : "false",
                 cmdOptions.addCommentsSymbolicExpresions ? "true" : "false",
+                cmdOptions.cacheSolverResultsOnDisk ? "true" : "false",
+                cmdOptions.solverPortfolio ? "true" : "false",
+                cmdOptions.exportSolverQueries ? "true" : "false",
                 cmdOptions.color_tainted,
                 cmdOptions.color_executed_instruction,
                 cmdOptions.color_tainted_condition
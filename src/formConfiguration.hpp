@@ -33,16 +33,27 @@ static const char form[] =
 "<#Perform a constant folding optimization of sub ASTs which do not contain symbolic variables#CONSTANT_FOLDING:C9>\n"
 "<#Symbolize index rotation for bvrol and bvror. This mode increases the complexity of solving#SYMBOLIZE_INDEX_ROTATION:C12>\n"
 "<#Classical arithmetic optimisations to reduce the depth of the trees#AST_OPTIMIZATIONS:C13>\n"
-"<#Spread the taint if an index pointer is already tainted#TAINT_THROUGH_POINTERS:C14>>\n"
+"<#Spread the taint if an index pointer is already tainted#TAINT_THROUGH_POINTERS:C14>\n"
+"<#Keep only the path constraint of the last iteration for the symbolic branches of the loops iterated many times#Summarize loops:C30>>\n"
 //
 "<#Add comments to controlled operands#IDA View expand info#Add comments with controlled operands:C15>\n"
 "<#This helps to track the tainted functions in large programms#Add prefix to tainted function names:C16>\n"
 "<#Will add a comment for every instruction with his symbolic expression. Will dirt the IDA view.#Add comments with symbolic expresions:C17>>\n"
+//
+"<#Save the solver results in the IDA user directory and reuse them the next time this binary is solved#Solver#Cache solver results on disk:C23>\n"
+"<#Solve every query with several Z3 strategies in parallel and take the first answer#Race several solver strategies:C26>\n"
+"<#Write every query to the IDA user directory as SMT-LIB with its solve time, ponce-bench solves them again#Export solver queries:C27>>\n"
 "\n"
 "Ponce will heads up you after:\n"
 "<#Time in seconds#Seconds running               :D1:12:12>\n"
 "<#Number of the instructions executed during tracing before ask to the user#Instructions executed         :D2:12:12>\n"
 "\n"
+"<#Seconds a query can run before giving up, 0 for no limit#Solver timeout in seconds     :D24:12:12>\n"
+"<#Memory the solver can use, 0 for no limit#Solver memory limit in MB     :D25:12:12>\n"
+"\n"
+"<#Memory IDA can use before Ponce concretizes the dead stack and drops the old path constraints, 0 for no limit#Memory budget in MB           :D28:12:12>\n"
+"<#Only the last path constraints are kept, the older branches can not be solved anymore. 0 keeps all of them#Path constraints window       :D29:12:12>\n"
+"\n"
 "<#-1 is default colour#Color Tainted Instruction     :K19:::>\n"
 "<#-1 is default colour#Color Executed Instruction    :K20:::>\n"
 "<#-1 is default colour#Color Tainted Condition       :K21:::>\n"
@@ -0,0 +1,41 @@
+//! \file
+/*
+**  Copyright (c) 2020 - Ponce
+**  Authors:
+**         Alberto Garcia Illera        agarciaillera@gmail.com
+**         Francisco Oca                francisco.oca.gonzalez@gmail.com
+**
+**  This program is under the terms of the BSD License.
+*/
+
+#include "formula.hpp"
+
+/*Returns a formula for every non taken branch of the path constraint at path_constraint_index (more than one is possible under certain situations, like switches).
+Every formula is the conjunction of the taken predicates of the previous path constraints, the extra constraints and the non taken branch constraint.
+Returns an empty vector if path_constraint_index is out of range*/
+std::vector<branch_formula_t> build_branch_formulas(triton::API& api, size_t path_constraint_index, const triton::ast::SharedAbstractNode& extra_constraints)
+{
+    std::vector<branch_formula_t> formulas;
+    const auto& pathConstrains = api.getPathConstraints();
+    if (path_constraint_index >= pathConstrains.size())
+        return formulas;
+
+    auto ast = api.getAstContext();
+    // We are going to store here the constraints for the previous conditions
+    // We can not initializate this to null, so we do it to a true condition (based on code_coverage_crackme_xor.py from the triton project)
+    auto previousConstraints = extra_constraints ? extra_constraints : ast->equal(ast->bvtrue(), ast->bvtrue());
+
+    // First we iterate through the previous path constrains to add the predicates of the taken path
+    for (size_t j = 0; j < path_constraint_index; j++) {
+        previousConstraints = ast->land(previousConstraints, pathConstrains[j].getTakenPredicate());
+    }
+
+    // Then we use the predicate for the non taken path so we "solve" that condition.
+    for (auto const& [taken, srcAddr, dstAddr, constraint] : pathConstrains[path_constraint_index].getBranchConstraints()) {
+        if (!taken) {
+            // We concatenate the previous constraints for the taken path plus the non taken constrain of the selected condition
+            formulas.push_back({ srcAddr, dstAddr, ast->land(previousConstraints, constraint) });
+        }
+    }
+    return formulas;
+}
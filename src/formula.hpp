@@ -0,0 +1,27 @@
+//! \file
+/*
+**  Copyright (c) 2020 - Ponce
+**  Authors:
+**         Alberto Garcia Illera        agarciaillera@gmail.com
+**         Francisco Oca                francisco.oca.gonzalez@gmail.com
+**
+**  This program is under the terms of the BSD License.
+*/
+
+/*Builds the formulas we ask the solver. It must not depend on IDA since it is shared with the offline tools*/
+
+#pragma once
+
+#include <vector>
+
+//Triton
+#include <triton/api.hpp>
+
+//The formula to take a branch the execution did not take
+struct branch_formula_t {
+    triton::uint64 srcAddr;
+    triton::uint64 dstAddr;
+    triton::ast::SharedAbstractNode formula;
+};
+
+std::vector<branch_formula_t> build_branch_formulas(triton::API& api, size_t path_constraint_index, const triton::ast::SharedAbstractNode& extra_constraints = nullptr);
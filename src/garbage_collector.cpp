@@ -0,0 +1,143 @@
+//! \file
+/*
+**  Copyright (c) 2020 - Ponce
+**  Authors:
+**         Alberto Garcia Illera        agarciaillera@gmail.com
+**         Francisco Oca                francisco.oca.gonzalez@gmail.com
+**
+**  This program is under the terms of the BSD License.
+*/
+
+#include <vector>
+
+#ifdef __NT__
+#include <Windows.h>
+#include <psapi.h>
+#elif __MAC__
+#include <mach/mach.h>
+#else
+#include <cstdio>
+#include <unistd.h>
+#endif
+
+//Ponce
+#include "garbage_collector.hpp"
+#include "globals.hpp"
+#include "solver.hpp"
+#include "solver_job.hpp"
+#include "engine_edits.hpp"
+
+//IDA
+#include <ida.hpp>
+#include <segment.hpp>
+
+//Triton
+#include <triton/api.hpp>
+
+size_t get_process_memory_mb()
+{
+#ifdef __NT__
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0;
+    return counters.WorkingSetSize >> 20;
+#elif __MAC__
+    mach_task_basic_info_data_t info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &count) != KERN_SUCCESS)
+        return 0;
+    return info.resident_size >> 20;
+#else
+    FILE* statm = fopen("/proc/self/statm", "r");
+    if (statm == nullptr)
+        return 0;
+    unsigned long size = 0, resident = 0;
+    int read = fscanf(statm, "%lu %lu", &size, &resident);
+    fclose(statm);
+    if (read != 2)
+        return 0;
+    return (size_t)(((unsigned long long)resident * sysconf(_SC_PAGESIZE)) >> 20);
+#endif
+}
+
+//The over budget warning is only shown once per session
+static bool budget_warned = false;
+
+/*The frames below the stack pointer were already returned, their memory cells are garbage. We only look at the
+segment of the stack pointer since the heap could be below the stack*/
+static size_t concretize_dead_stack()
+{
+    auto sp = api.getConcreteRegisterValue(api.getCpuInstance()->getStackPointer()).convert_to<triton::uint64>();
+    segment_t* stack = getseg((ea_t)sp);
+    if (stack == nullptr || sp < stack->start_ea + GC_STACK_RED_ZONE)
+        return 0;
+    triton::uint64 dead_end = sp - GC_STACK_RED_ZONE;
+
+    std::vector<triton::uint64> dead;
+    for (const auto& [address, expression] : api.getSymbolicMemory()) {
+        if (address >= stack->start_ea && address < dead_end)
+            dead.push_back(address);
+    }
+    for (auto address : dead) {
+        api.concretizeMemory(address);
+        trace_recorder.recordConcretizeMemory((ea_t)address, 1);
+    }
+    return dead.size();
+}
+
+/*Drops the oldest path constraints. The branches before the window can not be negated anymore and the solutions
+only follow the path inside the window*/
+static size_t apply_path_constraints_window()
+{
+    size_t path_constraints = api.getPathConstraints().size();
+    if (!cmdOptions.pathConstraintsWindow || path_constraints <= cmdOptions.pathConstraintsWindow)
+        return 0;
+    size_t dropped = path_constraints - (size_t)cmdOptions.pathConstraintsWindow;
+    erase_path_constraints(api, 0, dropped);
+    trace_recorder.recordErasePathConstraints(0, dropped);
+    branch_index.invalidate();
+    return dropped;
+}
+
+size_t collect_symbolic_garbage()
+{
+    size_t cells = concretize_dead_stack();
+    size_t constraints = apply_path_constraints_window();
+    if (cells == 0 && constraints == 0)
+        return 0;
+
+    //The solver contexts and the enumerated models keep their own copy of the dropped predicates
+    incremental_solver.reset();
+    clear_enumerations();
+    if (cmdOptions.showDebugInfo)
+        msg("[+] Garbage collected: %u dead stack cells concretized, %u old path constraints dropped\n", (unsigned int)cells, (unsigned int)constraints);
+    return cells + constraints;
+}
+
+void check_memory_budget()
+{
+    if (!cmdOptions.memoryBudget && !cmdOptions.pathConstraintsWindow)
+        return;
+    //The solver job reads the path constraints from its thread
+    if (is_solver_job_running())
+        return;
+
+    if (cmdOptions.memoryBudget && get_process_memory_mb() > cmdOptions.memoryBudget) {
+        collect_symbolic_garbage();
+        //The allocator does not always give the memory back to the system, so this is only a hint
+        size_t used = get_process_memory_mb();
+        if (used > cmdOptions.memoryBudget && !budget_warned) {
+            msg("[!] Ponce is using %u MB, over the memory budget of %u MB. Set a smaller path constraints window or take fewer snapshots\n", (unsigned int)used, (unsigned int)cmdOptions.memoryBudget);
+            budget_warned = true;
+        }
+    }
+    else if (apply_path_constraints_window()) {
+        incremental_solver.reset();
+        clear_enumerations();
+    }
+}
+
+void reset_memory_budget_warning()
+{
+    budget_warned = false;
+}
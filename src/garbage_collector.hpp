@@ -0,0 +1,37 @@
+//! \file
+/*
+**  Copyright (c) 2020 - Ponce
+**  Authors:
+**         Alberto Garcia Illera        agarciaillera@gmail.com
+**         Francisco Oca                francisco.oca.gonzalez@gmail.com
+**
+**  This program is under the terms of the BSD License.
+*/
+
+/*Keeps long traces under the memory budget of the configuration. Triton frees a symbolic expression when nothing
+references it, so the collector removes the references that are not needed anymore:
+- the memory cells of the stack frames already returned (below the stack pointer) are concretized
+- only the last path constraints are kept when the path constraints window is set*/
+
+#pragma once
+
+//IDA
+#include <pro.h>
+
+//Traced instructions between two checks of the memory budget
+#define GC_CHECK_PERIOD 10000
+
+//Bytes below the stack pointer a leaf function can still use (red zone of the System V x64 ABI)
+#define GC_STACK_RED_ZONE 128
+
+//Resident memory of the IDA process in MB, 0 if it can not be known
+size_t get_process_memory_mb();
+
+//Called every GC_CHECK_PERIOD traced instructions, it collects if the budget or the window are exceeded
+void check_memory_budget();
+
+//Concretizes the dead stack and applies the path constraints window. Returns the number of references removed
+size_t collect_symbolic_garbage();
+
+//Shows the over budget warning again, called when the engines are restarted
+void reset_memory_budget_warning();
@@ -30,11 +30,32 @@ struct cmdOptionStruct cmdOptions;
 //Snapshot object, defined in the snapshot.cpp
 Snapshot snapshot = Snapshot();
 
+//Every Triton instruction used by tritonize comes from this pool. It owns them, see instruction_pool.hpp
+InstructionPool instruction_pool;
+
+//Execution trace being recorded, if any. See trace_format.hpp
+TraceRecorder trace_recorder;
+
+//Back-edges of the trace, see loop_detector.hpp
+LoopDetector loop_detector;
+
+//Path constraints by branch address for the disassembly popup, see branch_index.hpp
+BranchIndex branch_index;
+
+//Verdicts of the queries already solved, see query_cache.hpp
+QueryCache query_cache;
+
+//Where the solver queries are exported, see query_corpus.hpp
+QueryCorpus query_corpus;
+
+//Solver with the path constraints predicates already asserted, see incremental_solver.hpp
+IncrementalSolver incremental_solver(&query_cache);
+
 //Used to point to the vector of blacklisted user functions
 std::vector<std::string>* blacklkistedUserFunctions = nullptr;
 
 triton::API api;
 
-std::map<ea_t, struct instruction_info> ponce_comments;
+AnnotationStore ponce_comments;
 
 
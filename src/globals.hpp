@@ -12,8 +12,14 @@
 //Ponce
 #include "trigger.hpp"
 #include "snapshot.hpp"
+#include "instruction_pool.hpp"
+#include "trace_recorder.hpp"
+#include "loop_detector.hpp"
+#include "branch_index.hpp"
+#include "incremental_solver.hpp"
 #include "runtime_status.hpp"
 #include "symVarTable.hpp"
+#include "annotation_store.hpp"
 
 //IDA
 #include <kernwin.hpp>
@@ -41,6 +47,19 @@
 
 extern Snapshot snapshot;
 
+extern InstructionPool instruction_pool;
+
+extern TraceRecorder trace_recorder;
+
+extern LoopDetector loop_detector;
+extern BranchIndex branch_index;
+
+extern QueryCache query_cache;
+
+extern QueryCorpus query_corpus;
+
+extern IncrementalSolver incremental_solver;
+
 //All the global variables:
 extern bool hooked;
 
@@ -48,6 +67,10 @@ extern bool hooked;
 struct cmdOptionStruct {
     uint64 limitInstructionsTracingMode = 10000;
     uint64 limitTime = 60; //seconds
+    uint64 solverTimeout = 60; //seconds per query, 0 no limit
+    uint64 solverMemoryLimit = 4096; //MB, 0 no limit
+    uint64 memoryBudget = 0; //MB used by IDA before collecting the symbolic garbage, 0 no limit
+    uint64 pathConstraintsWindow = 0; //Path constraints kept, the oldest are dropped. 0 keeps all of them
 
     //all this variables should be false and initialized in prompt_conf_window in utils.cpp
     bool already_configured = false; // We use this variable to know if the user already configured anything or if this is the first configuration promt
@@ -68,11 +91,16 @@ struct cmdOptionStruct {
     bool CONSTANT_FOLDING = false;
     bool SYMBOLIZE_INDEX_ROTATION = false;
     bool TAINT_THROUGH_POINTERS = false;
+    bool summarizeLoops = false;
 
     bool addCommentsControlledOperands = false;
     bool RenameTaintedFunctionNames = false;
     bool addCommentsSymbolicExpresions = false;
 
+    bool cacheSolverResultsOnDisk = false;
+    bool solverPortfolio = false;
+    bool exportSolverQueries = false;
+
     char blacklist_path[QMAXPATH];
 };
 extern struct cmdOptionStruct cmdOptions;
@@ -83,18 +111,13 @@ extern void idaapi term(void);
 
 extern triton::API api;
 
-struct instruction_info {
-    std::string comment;
-    std::string snapshot_comment;
-    bgcolor_t color = DEFCOLOR;
-
-};
-extern std::map<ea_t, struct instruction_info> ponce_comments;
+extern AnnotationStore ponce_comments;
 /* For backwards compatibility with IDA SDKs < 7.3 */
 #if IDA_SDK_VERSION < 730
 #define inf_get_min_ea()        inf.min_ea
 #define inf_is_64bit()          inf.is_64bit()
 #define inf_is_32bit()          inf.is_32bit()
+#define inf_get_filetype()      inf.filetype
 #define WOPN_DP_TAB             WOPN_TAB
 #endif
 
@@ -0,0 +1,429 @@
+//! \file
+/*
+**  Copyright (c) 2020 - Ponce
+**  Authors:
+**         Alberto Garcia Illera        agarciaillera@gmail.com
+**         Francisco Oca                francisco.oca.gonzalez@gmail.com
+**
+**  This program is under the terms of the BSD License.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <set>
+#include <stack>
+#include <string>
+#include <unordered_set>
+
+#include "incremental_solver.hpp"
+
+/*Once we have discarded this many predicates (snapshot restores, new runs) we start again with a fresh solver*/
+#define MAX_DISCARDED_PREDICATES 4096
+
+/*Returns the ids of the symbolic variables of an AST, sorted. The referenced expressions are followed*/
+static std::vector<triton::usize> get_variables(const triton::ast::SharedAbstractNode& node) {
+    std::set<triton::usize> variables;
+    std::unordered_set<triton::ast::AbstractNode*> visited;
+    std::stack<triton::ast::AbstractNode*> worklist;
+    worklist.push(node.get());
+    while (!worklist.empty()) {
+        triton::ast::AbstractNode* current = worklist.top();
+        worklist.pop();
+        if (!visited.insert(current).second)
+            continue;
+
+        switch (current->getType()) {
+        case triton::ast::VARIABLE_NODE:
+            variables.insert(reinterpret_cast<triton::ast::VariableNode*>(current)->getSymbolicVariable()->getId());
+            break;
+        case triton::ast::REFERENCE_NODE:
+            worklist.push(reinterpret_cast<triton::ast::ReferenceNode*>(current)->getSymbolicExpression()->getAst().get());
+            break;
+        default:
+            for (const auto& child : current->getChildren())
+                worklist.push(child.get());
+            break;
+        }
+    }
+    return std::vector<triton::usize>(variables.begin(), variables.end());
+}
+
+
+IncrementalSolver::IncrementalSolver(QueryCache* cache) {
+    this->asserted = 0;
+    this->cache = cache;
+    this->interrupted = false;
+    this->use_portfolio = false;
+    this->corpus = nullptr;
+}
+
+
+void IncrementalSolver::reset(void) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    std::lock_guard<std::mutex> context_lock(this->context_mutex);
+    this->predicates.clear();
+    this->solver.reset();
+    this->converter.reset();
+    this->asserted = 0;
+}
+
+
+void IncrementalSolver::setLimits(const solver_limits_t& limits) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->limits = limits;
+    if (limits.memory_mb)
+        z3::set_param("memory_max_size", (int)limits.memory_mb);
+    if (this->solver) {
+        z3::params params(this->converter->context);
+        params.set("timeout", limits.timeout_ms ? limits.timeout_ms : UINT_MAX);
+        this->solver->set(params);
+    }
+}
+
+
+void IncrementalSolver::setPortfolio(bool enabled) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->use_portfolio = enabled;
+}
+
+
+void IncrementalSolver::setCorpus(QueryCorpus* corpus) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->corpus = corpus;
+}
+
+
+void IncrementalSolver::interrupt(void) {
+    this->interrupted = true;
+    this->portfolio.interrupt();
+    std::lock_guard<std::mutex> context_lock(this->context_mutex);
+    if (this->converter)
+        this->converter->context.interrupt();
+}
+
+
+/*Z3 may keep an interrupted context cancelled, the next queries start with a fresh one*/
+void IncrementalSolver::clearInterrupt(void) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->portfolio.clearInterrupt();
+    if (!this->interrupted.exchange(false))
+        return;
+
+    std::lock_guard<std::mutex> context_lock(this->context_mutex);
+    this->predicates.clear();
+    this->solver.reset();
+    this->converter.reset();
+    this->asserted = 0;
+}
+
+
+bool IncrementalSolver::isInterrupted(void) const {
+    return this->interrupted;
+}
+
+
+/*Every taken predicate is asserted as guard => predicate, and the queries assume the guards of the prefix they need.
+If the path constraints change (a snapshot is restored or the engines restarted) the predicates from the first
+different one get new guards, the old ones are never assumed again*/
+void IncrementalSolver::sync(triton::API& api) {
+    const auto& pathConstraints = api.getPathConstraints();
+
+    std::lock_guard<std::mutex> context_lock(this->context_mutex);
+    if (this->asserted - this->predicates.size() > MAX_DISCARDED_PREDICATES) {
+        this->predicates.clear();
+        this->solver.reset();
+        this->converter.reset();
+        this->asserted = 0;
+    }
+    if (!this->converter) {
+        this->converter = std::make_unique<triton::ast::TritonToZ3Ast>(false);
+        this->solver = std::make_unique<z3::solver>(this->converter->context);
+        z3::params params(this->converter->context);
+        params.set("timeout", this->limits.timeout_ms ? this->limits.timeout_ms : UINT_MAX);
+        this->solver->set(params);
+    }
+
+    // First path constraint we have not asserted or that changed
+    size_t first = 0;
+    while (first < this->predicates.size() && first < pathConstraints.size() && this->predicates[first].node == pathConstraints[first].getTakenPredicate())
+        first++;
+    this->predicates.erase(this->predicates.begin() + first, this->predicates.end());
+
+    for (size_t i = first; i < pathConstraints.size(); i++) {
+        auto predicate = pathConstraints[i].getTakenPredicate();
+        std::string guard_name = "ponce_path_constraint_" + std::to_string(this->asserted++);
+        z3::expr guard = this->converter->context.bool_const(guard_name.c_str());
+        z3::expr z3_predicate = this->converter->convert(predicate);
+        this->solver->add(z3::implies(guard, z3_predicate));
+        this->predicates.push_back({ predicate, guard, z3_predicate, QueryCache::hashText(z3_predicate.to_string()), get_variables(predicate) });
+    }
+}
+
+
+/*Independence slicing (like KLEE): the predicates not sharing variables with the branch, directly or through other
+predicates, are satisfied by the current values of their variables whatever the model is, so they are left out*/
+std::vector<size_t> IncrementalSolver::slice(size_t path_constraint_index, const triton::ast::SharedAbstractNode& constraint, const triton::ast::SharedAbstractNode& extra_constraints) const {
+    std::set<triton::usize> variables;
+    for (auto id : get_variables(constraint))
+        variables.insert(id);
+    if (extra_constraints) {
+        for (auto id : get_variables(extra_constraints))
+            variables.insert(id);
+    }
+
+    std::vector<bool> selected(path_constraint_index, false);
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t j = 0; j < path_constraint_index; j++) {
+            const auto& predicate_variables = this->predicates[j].variables;
+            if (selected[j] || std::none_of(predicate_variables.begin(), predicate_variables.end(), [&](triton::usize id) { return variables.count(id) != 0; }))
+                continue;
+            selected[j] = true;
+            variables.insert(predicate_variables.begin(), predicate_variables.end());
+            changed = true;
+        }
+    }
+
+    std::vector<size_t> indexes;
+    for (size_t j = 0; j < path_constraint_index; j++) {
+        if (selected[j])
+            indexes.push_back(j);
+    }
+    return indexes;
+}
+
+
+/*The cached models store the variable ids, they are valid while the variables exist. Returns false if any is missing*/
+bool IncrementalSolver::getModel(triton::API& api, const query_result_t& result, std::unordered_map<triton::usize, triton::engines::solver::SolverModel>& model) {
+    for (const auto& [id, value] : result.model) {
+        try {
+            model[id] = triton::engines::solver::SolverModel(api.getSymbolicVariable(id), value);
+        }
+        catch (const triton::exceptions::Exception&) {
+            model.clear();
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/*A cached model comes from a query with the same key, it is checked against this one before injecting it*/
+bool IncrementalSolver::checkModel(triton::API& api, const z3::expr_vector& query, const std::unordered_map<triton::usize, triton::engines::solver::SolverModel>& model) {
+    z3::context& ctx = this->converter->context;
+    z3::expr_vector variables(ctx);
+    z3::expr_vector values(ctx);
+    for (const auto& [name, variable] : this->converter->variables) {
+        auto it = model.find(variable->getId());
+        triton::uint512 value = it != model.end() ? it->second.getValue() : api.getConcreteVariableValue(variable);
+        variables.push_back(ctx.bv_const(name.c_str(), variable->getSize()));
+        values.push_back(ctx.bv_val(value.str().c_str(), variable->getSize()));
+    }
+    return z3::mk_and(query).substitute(variables, values).simplify().is_true();
+}
+
+
+/*Converts a Z3 model. The guards are in the model too, only the symbolic variables are kept.
+Returns the expression forbidding the model, false if it has no variable*/
+z3::expr IncrementalSolver::getModel(const z3::model& z3_model, std::unordered_map<triton::usize, triton::engines::solver::SolverModel>& model, query_result_t* result) {
+    z3::context& ctx = this->converter->context;
+    z3::expr blocking = ctx.bool_val(false);
+    for (unsigned int i = 0; i < z3_model.size(); i++) {
+        z3::func_decl decl = z3_model[i];
+        auto it = this->converter->variables.find(decl.name().str());
+        if (it == this->converter->variables.end())
+            continue;
+        z3::expr value = z3_model.get_const_interp(decl);
+        triton::uint512 concrete_value{ Z3_get_numeral_string(ctx, value) };
+        model[it->second->getId()] = triton::engines::solver::SolverModel(it->second, concrete_value);
+        if (result)
+            result->model.emplace_back(it->second->getId(), concrete_value);
+        blocking = blocking || decl() != value;
+    }
+    return blocking;
+}
+
+
+/*For a branch with a non taken side (a conditional jump) the models are different inputs reaching it. For a branch with only
+the taken side, the jump target is symbolic (switch tables, indirect calls), the models reach different targets*/
+std::vector<branch_model_t> IncrementalSolver::enumerate(triton::API& api, size_t path_constraint_index, size_t max_models, const triton::ast::SharedAbstractNode& extra_constraints) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    std::vector<branch_model_t> models;
+
+    const auto& pathConstraints = api.getPathConstraints();
+    if (path_constraint_index >= pathConstraints.size())
+        return models;
+
+    this->sync(api);
+    z3::context& ctx = this->converter->context;
+
+    const auto& branches = pathConstraints[path_constraint_index].getBranchConstraints();
+    bool multiple_targets = std::none_of(branches.begin(), branches.end(), [](const auto& branch) { return !std::get<0>(branch); });
+
+    for (auto const& [taken, srcAddr, dstAddr, constraint] : branches) {
+        if ((taken && !multiple_targets) || this->interrupted)
+            continue;
+
+        // The taken predicate of a symbolic jump is (= target concrete_target)
+        z3::expr target = ctx.bool_val(true);
+        if (multiple_targets) {
+            if (constraint->getType() != triton::ast::EQUAL_NODE)
+                continue;
+            target = this->converter->convert(constraint->getChildren()[0]);
+        }
+
+        z3::expr_vector assumptions(ctx);
+        for (size_t j : this->slice(path_constraint_index, constraint, extra_constraints))
+            assumptions.push_back(this->predicates[j].guard);
+
+        // Every model found is forbidden for the next queries inside this scope
+        this->solver->push();
+        z3::expr z3_constraint = this->converter->convert(constraint);
+        this->solver->add(multiple_targets ? !z3_constraint : z3_constraint);
+        if (extra_constraints)
+            this->solver->add(this->converter->convert(extra_constraints));
+
+        while (models.size() < max_models && !this->interrupted && this->solver->check(assumptions) == z3::sat) {
+            z3::model z3_model = this->solver->get_model();
+            branch_model_t branch_model;
+            branch_model.srcAddr = srcAddr;
+            branch_model.dstAddr = dstAddr;
+            z3::expr blocking = this->getModel(z3_model, branch_model.model, nullptr);
+            if (multiple_targets) {
+                z3::expr value = z3_model.eval(target, true);
+                branch_model.dstAddr = triton::uint512{ Z3_get_numeral_string(ctx, value) }.convert_to<triton::uint64>();
+                blocking = target != value;
+            }
+            models.push_back(branch_model);
+            if (blocking.is_false())
+                break;
+            this->solver->add(blocking);
+        }
+        this->solver->pop();
+    }
+    return models;
+}
+
+
+std::vector<branch_model_t> IncrementalSolver::solve(triton::API& api, size_t path_constraint_index, const triton::ast::SharedAbstractNode& extra_constraints) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    std::vector<branch_model_t> models;
+
+    const auto& pathConstraints = api.getPathConstraints();
+    if (path_constraint_index >= pathConstraints.size())
+        return models;
+
+    this->sync(api);
+    z3::context& ctx = this->converter->context;
+
+    for (auto const& [taken, srcAddr, dstAddr, constraint] : pathConstraints[path_constraint_index].getBranchConstraints()) {
+        if (taken || this->interrupted)
+            continue;
+
+        branch_model_t branch_model;
+        branch_model.srcAddr = srcAddr;
+        branch_model.dstAddr = dstAddr;
+
+        // The previous conditions the branch depends on are assumed, not asserted, so the solver can be reused for any index.
+        // The query is those conditions, the branch and the extra constraints, the hash of their text is the cache key
+        z3::expr_vector assumptions(ctx);
+        z3::expr_vector query(ctx);
+        triton::uint512 hash = 0;
+        for (size_t j : this->slice(path_constraint_index, constraint, extra_constraints)) {
+            assumptions.push_back(this->predicates[j].guard);
+            query.push_back(this->predicates[j].predicate);
+            hash = QueryCache::combine(hash, this->predicates[j].hash);
+        }
+        query.push_back(this->converter->convert(constraint));
+        hash = QueryCache::combine(hash, QueryCache::hashText(query.back().to_string()));
+        if (extra_constraints) {
+            query.push_back(this->converter->convert(extra_constraints));
+            hash = QueryCache::combine(hash, QueryCache::hashText(query.back().to_string()));
+        }
+
+        // The models found in the cache are checked, a wrong one would inject an input missing the branch
+        query_result_t result;
+        if (this->cache && this->cache->lookup(hash, result)) {
+            if (!result.sat || (this->getModel(api, result, branch_model.model) && this->checkModel(api, query, branch_model.model))) {
+                models.push_back(branch_model);
+                continue;
+            }
+            branch_model.model.clear();
+            result = query_result_t();
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        z3::check_result verdict;
+        if (this->use_portfolio) {
+            portfolio_result_t portfolio_result = this->portfolio.solve(ctx, query, this->limits.timeout_ms);
+            verdict = portfolio_result.verdict;
+            for (const auto& [name, concrete_value] : portfolio_result.model) {
+                auto it = this->converter->variables.find(name);
+                if (it == this->converter->variables.end())
+                    continue;
+                branch_model.model[it->second->getId()] = triton::engines::solver::SolverModel(it->second, concrete_value);
+                result.model.emplace_back(it->second->getId(), concrete_value);
+            }
+        }
+        else {
+            // The predicates are already asserted, only the branch and the extra constraints are new
+            this->solver->push();
+            for (unsigned int i = assumptions.size(); i < query.size(); i++)
+                this->solver->add(query[i]);
+            verdict = this->solver->check(assumptions);
+            if (verdict == z3::sat)
+                this->getModel(this->solver->get_model(), branch_model.model, &result);
+            this->solver->pop();
+        }
+        double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        if (this->cache && verdict != z3::unknown) {
+            result.sat = verdict == z3::sat;
+            this->cache->insert(hash, result);
+        }
+
+        if (this->corpus) {
+            z3::solver printer(ctx);
+            printer.add(query);
+            this->corpus->add(hash, printer.to_smt2(), verdict == z3::sat ? "sat" : verdict == z3::unsat ? "unsat" : "unknown", milliseconds, srcAddr, dstAddr);
+        }
+
+        models.push_back(branch_model);
+    }
+    return models;
+}
+
+
+SolverGroup::SolverGroup() {
+    this->interrupted = false;
+}
+
+
+void SolverGroup::add(IncrementalSolver* solver) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->solvers.insert(solver);
+    if (this->interrupted)
+        solver->interrupt();
+}
+
+
+void SolverGroup::remove(IncrementalSolver* solver) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->solvers.erase(solver);
+}
+
+
+void SolverGroup::interrupt(void) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->interrupted = true;
+    for (auto* solver : this->solvers)
+        solver->interrupt();
+}
+
+
+void SolverGroup::clearInterrupt(void) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->interrupted = false;
+}
@@ -0,0 +1,183 @@
+//! \file
+/*
+**  Copyright (c) 2020 - Ponce
+**  Authors:
+**         Alberto Garcia Illera        agarciaillera@gmail.com
+**         Francisco Oca                francisco.oca.gonzalez@gmail.com
+**
+**  This program is under the terms of the BSD License.
+*/
+
+/*It must not depend on IDA since it is shared with the offline tools*/
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+//Triton
+#include <triton/api.hpp>
+#include <triton/tritonToZ3Ast.hpp>
+
+//Z3
+#include <z3++.h>
+
+//Ponce
+#include "query_cache.hpp"
+#include "solver_portfolio.hpp"
+#include "query_corpus.hpp"
+
+//The model to take a branch the execution did not take
+struct branch_model_t {
+    triton::uint64 srcAddr;
+    triton::uint64 dstAddr;
+    //Empty if the branch can not be taken
+    std::unordered_map<triton::usize, triton::engines::solver::SolverModel> model;
+};
+
+//Resources a query can use, 0 means no limit
+struct solver_limits_t {
+    unsigned int timeout_ms = 0;
+    //It applies to every Z3 context of the process
+    unsigned int memory_mb = 0;
+};
+
+//A taken predicate asserted in the solver
+struct asserted_predicate_t {
+    //Kept alive so a new predicate can not get its address once the path constraint is removed
+    triton::ast::SharedAbstractNode node;
+    //The literal guarding it, the queries needing the predicate assume it
+    z3::expr guard;
+    //The predicate converted to Z3
+    z3::expr predicate;
+    //Hash of the SMT-LIB text of the predicate, part of the cache keys
+    triton::uint512 hash;
+    //Ids of the symbolic variables in the predicate, sorted
+    std::vector<triton::usize> variables;
+};
+
+//! \class IncrementalSolver
+//! \brief Keeps the taken predicates of the path constraints asserted in a Z3 solver so every query only sends the new ones.
+//! A query only assumes the predicates sharing symbolic variables, directly or transitively, with the branch.
+class IncrementalSolver {
+
+private:
+    //! Converts the Triton ASTs to Z3. It owns the Z3 context, so it lives as long as the solver.
+    std::unique_ptr<triton::ast::TritonToZ3Ast> converter;
+
+    //! The solver with every taken predicate asserted.
+    std::unique_ptr<z3::solver> solver;
+
+    //! The taken predicate asserted for every path constraint.
+    std::vector<asserted_predicate_t> predicates;
+
+    //! Verdicts of previous queries, shared with other solvers. Can be null.
+    QueryCache* cache;
+
+    //! Number of predicates asserted, including the ones discarded because the path constraints changed.
+    size_t asserted;
+
+    //! The solving actions run in their own threads.
+    std::mutex mutex;
+
+    //! Protects the Z3 context from being destroyed while it is interrupted from another thread.
+    std::mutex context_mutex;
+
+    //! Set by interrupt(), the queries left are not solved.
+    std::atomic<bool> interrupted;
+
+    //! Limits of every query.
+    solver_limits_t limits;
+
+    //! Strategies raced when use_portfolio is set.
+    SolverPortfolio portfolio;
+
+    //! If set the queries are solved by the portfolio instead of the incremental solver.
+    bool use_portfolio;
+
+    //! Where the queries solved are written. Can be null.
+    QueryCorpus* corpus;
+
+    //! Asserts the predicates of the path constraints not asserted yet.
+    void sync(triton::API& api);
+
+    //! Returns the indexes of the predicates before path_constraint_index the query depends on.
+    std::vector<size_t> slice(size_t path_constraint_index, const triton::ast::SharedAbstractNode& constraint, const triton::ast::SharedAbstractNode& extra_constraints) const;
+
+    //! Converts a Z3 model, adding it to the cached result if given. Returns the expression forbidding it.
+    z3::expr getModel(const z3::model& z3_model, std::unordered_map<triton::usize, triton::engines::solver::SolverModel>& model, query_result_t* result);
+
+    //! Fills a model from a cached result. Returns false if a variable does not exist anymore.
+    bool getModel(triton::API& api, const query_result_t& result, std::unordered_map<triton::usize, triton::engines::solver::SolverModel>& model);
+
+    //! Returns true if the model satisfies the query. The variables not in the model keep their current value.
+    bool checkModel(triton::API& api, const z3::expr_vector& query, const std::unordered_map<triton::usize, triton::engines::solver::SolverModel>& model);
+
+public:
+    //! Constructor. The cache is optional.
+    IncrementalSolver(QueryCache* cache = nullptr);
+
+    //! Forgets every predicate. Called when the engines are restarted.
+    void reset(void);
+
+    //! Sets the limits of the next queries.
+    void setLimits(const solver_limits_t& limits);
+
+    //! Returns up to max_models different models for the branches of the path constraint at path_constraint_index.
+    //! If the branch target is symbolic every model reaches a different target, otherwise every model is a different input.
+    std::vector<branch_model_t> enumerate(triton::API& api, size_t path_constraint_index, size_t max_models, const triton::ast::SharedAbstractNode& extra_constraints = nullptr);
+
+    //! Races several strategies for every query. The portfolio does not reuse the asserted predicates.
+    void setPortfolio(bool enabled);
+
+    //! Writes every query solved to the corpus, null to stop.
+    void setCorpus(QueryCorpus* corpus);
+
+    //! Stops the query being solved and the ones left. Can be called from any thread.
+    void interrupt(void);
+
+    //! Allows solving again after interrupt().
+    void clearInterrupt(void);
+
+    //! Returns true if interrupt() was called since the last clearInterrupt().
+    bool isInterrupted(void) const;
+
+    //! Returns a model for every non taken branch of the path constraint at path_constraint_index,
+    //! assuming the taken predicates of the previous ones and the extra constraints.
+    std::vector<branch_model_t> solve(triton::API& api, size_t path_constraint_index, const triton::ast::SharedAbstractNode& extra_constraints = nullptr);
+};
+
+//! \class SolverGroup
+//! \brief The solvers working for the same job, so cancelling it interrupts the queries all of them are running.
+class SolverGroup {
+
+private:
+    //! The solvers registered and not removed yet.
+    std::set<IncrementalSolver*> solvers;
+
+    //! Set by interrupt(), the solvers added later are interrupted right away.
+    bool interrupted;
+
+    //! Solvers are added from their own threads and interrupted from any thread.
+    std::mutex mutex;
+
+public:
+    //! Constructor.
+    SolverGroup();
+
+    //! Registers a solver. It must be removed before it is destroyed.
+    void add(IncrementalSolver* solver);
+
+    //! Unregisters a solver.
+    void remove(IncrementalSolver* solver);
+
+    //! Interrupts every solver registered and the ones added until clearInterrupt(). Can be called from any thread.
+    void interrupt(void);
+
+    //! Lets the solvers added from now on solve.
+    void clearInterrupt(void);
+};
@@ -0,0 +1,91 @@
+//! \file
+/*
+**  Copyright (c) 2020 - Ponce
+**  Authors:
+**         Alberto Garcia Illera        agarciaillera@gmail.com
+**         Francisco Oca                francisco.oca.gonzalez@gmail.com
+**
+**  This program is under the terms of the BSD License.
+*/
+
+#include <unordered_map>
+#include <unordered_set>
+
+//Ponce
+#include "instruction_cache.hpp"
+#include "globals.hpp"
+
+//IDA
+#include <ida.hpp>
+#include <ua.hpp>
+#include <bytes.hpp>
+
+#define CODE_PAGE_SHIFT 12
+
+//Decoded instructions indexed by address. Hot loops are decoded only once
+std::unordered_map<ea_t, cached_instruction_t> instruction_cache;
+//Pages containing at least one cached instruction. Used to discard quickly the writes that do not touch code
+std::unordered_set<ea_t> instruction_cache_pages;
+
+/*Returns the cached instruction at pc, decoding it with IDA the first time we see it.
+Returns nullptr if IDA can not decode the instruction*/
+const cached_instruction_t* get_cached_instruction(ea_t pc)
+{
+    auto it = instruction_cache.find(pc);
+    if (it != instruction_cache.end())
+        return &it->second;
+
+    /*This will fill the 'cmd' (to get the instruction size) which is a insn_t structure https://www.hex-rays.com/products/ida/support/sdkdoc/classinsn__t.html */
+    if (!can_decode(pc))
+        return nullptr;
+
+    insn_t ins;
+    if (decode_insn(&ins, pc) <= 0 || ins.size > MAX_INSTRUCTION_SIZE)
+        return nullptr;
+
+    cached_instruction_t cached;
+    cached.size = ins.size;
+    cached.itype = ins.itype;
+    if (get_bytes(cached.opcodes, cached.size, pc, GMB_READALL, NULL) != (ssize_t)cached.size)
+        return nullptr;
+
+    instruction_cache_pages.insert(pc >> CODE_PAGE_SHIFT);
+    instruction_cache_pages.insert((pc + cached.size - 1) >> CODE_PAGE_SHIFT);
+    return &(instruction_cache[pc] = cached);
+}
+
+/*This is called for every memory write. If the program writes over an instruction we have cached (self modifying code)
+we need to decode it again the next time it is executed*/
+void invalidate_instruction_cache(ea_t address, size_t size)
+{
+    if (instruction_cache.empty() || size == 0)
+        return;
+
+    //Most of the writes go to the stack or the heap, so we first check if the write touches any code page
+    bool touches_code = false;
+    for (ea_t page = (address - MAX_INSTRUCTION_SIZE) >> CODE_PAGE_SHIFT; page <= (address + size - 1) >> CODE_PAGE_SHIFT; page++) {
+        if (instruction_cache_pages.count(page) > 0) {
+            touches_code = true;
+            break;
+        }
+    }
+    if (!touches_code)
+        return;
+
+    //Any instruction starting in the previous MAX_INSTRUCTION_SIZE bytes could overlap with the write
+    for (ea_t ea = address - MAX_INSTRUCTION_SIZE + 1; ea != address + size; ea++) {
+        auto it = instruction_cache.find(ea);
+        if (it != instruction_cache.end() && ea + it->second.size > address) {
+            if (cmdOptions.showExtraDebugInfo)
+                msg("[+] Self modifying code detected. Instruction at " MEM_FORMAT " will be decoded again\n", ea);
+            instruction_cache.erase(it);
+        }
+    }
+}
+
+/*We need to clean the cache every time the segments can change (new process, library load/unload...)*/
+void clear_instruction_cache()
+{
+    instruction_cache.clear();
+    instruction_cache_pages.clear();
+}
@@ -0,0 +1,32 @@
+//! \file
+/*
+**  Copyright (c) 2020 - Ponce
+**  Authors:
+**         Alberto Garcia Illera        agarciaillera@gmail.com
+**         Francisco Oca                francisco.oca.gonzalez@gmail.com
+**
+**  This program is under the terms of the BSD License.
+*/
+
+#pragma once
+//Triton
+#include <triton/tritonTypes.hpp>
+//IDA
+#include <pro.h>
+
+//Biggest instruction we can find in the supported architectures (x86 is 15 bytes)
+#define MAX_INSTRUCTION_SIZE 16
+
+//This struct stores everything we need from IDA to tritonize an instruction
+struct cached_instruction_t {
+    //The opcodes read from the debugged process
+    triton::uint8 opcodes[MAX_INSTRUCTION_SIZE];
+    //The instruction size given by decode_insn
+    triton::uint32 size;
+    //The IDA instruction type (NN_call, NN_jmp...)
+    uint16 itype;
+};
+
+const cached_instruction_t* get_cached_instruction(ea_t pc);
+void invalidate_instruction_cache(ea_t address, size_t size);
+void clear_instruction_cache();
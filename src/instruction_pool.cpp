@@ -0,0 +1,30 @@
+//! \file
+/*
+**  Copyright (c) 2020 - Ponce
+**  Authors:
+**         Alberto Garcia Illera        agarciaillera@gmail.com
+**         Francisco Oca                francisco.oca.gonzalez@gmail.com
+**
+**  This program is under the terms of the BSD License.
+*/
+
+#include "instruction_pool.hpp"
+
+InstructionPool::InstructionPool() {
+    this->instructions.resize(INSTRUCTION_POOL_SIZE);
+    this->next = 0;
+}
+
+/* Hand out the next instruction of the ring. We reuse the objects so we don't call the allocator for every traced instruction */
+triton::arch::Instruction* InstructionPool::acquire(void) {
+    triton::arch::Instruction* instruction = &this->instructions[this->next];
+    this->next = (this->next + 1) % this->instructions.size();
+    instruction->clear();
+    return instruction;
+}
+
+void InstructionPool::reset(void) {
+    for (auto& instruction : this->instructions)
+        instruction.clear();
+    this->next = 0;
+}
@@ -0,0 +1,46 @@
+//! \file
+/*
+**  Copyright (c) 2020 - Ponce
+**  Authors:
+**         Alberto Garcia Illera        agarciaillera@gmail.com
+**         Francisco Oca                francisco.oca.gonzalez@gmail.com
+**
+**  This program is under the terms of the BSD License.
+*/
+
+#pragma once
+
+#include <vector>
+
+//Triton
+#include <triton/instruction.hpp>
+
+//Number of instructions in the ring. A borrowed instruction stays valid until this many instructions are acquired after it
+#define INSTRUCTION_POOL_SIZE 8
+
+//! \class InstructionPool
+//! \brief A ring of preallocated Triton instructions reused by tritonize().
+/*Ownership rules:
+- The pool owns every instruction. Nobody must delete an instruction returned by acquire().
+- ponce_runtime_status.last_triton_instruction only borrows the last acquired instruction.
+- A borrowed pointer is valid until INSTRUCTION_POOL_SIZE more instructions are acquired or the pool is reset.
+  That is why the snapshot engine must not restore a saved last_triton_instruction, it could be recycled already.*/
+class InstructionPool {
+
+private:
+    //! The preallocated instructions.
+    std::vector<triton::arch::Instruction> instructions;
+
+    //! Index of the next instruction to hand out.
+    size_t next;
+
+public:
+    //! Constructor.
+    InstructionPool();
+
+    //! Returns the next instruction of the ring, cleared and ready to be filled.
+    triton::arch::Instruction* acquire(void);
+
+    //! Clears every instruction. Every borrowed pointer is invalid after this.
+    void reset(void);
+};
@@ -0,0 +1,81 @@
+//! \file
+/*
+**  Copyright (c) 2020 - Ponce
+**  Authors:
+**         Alberto Garcia Illera        agarciaillera@gmail.com
+**         Francisco Oca                francisco.oca.gonzalez@gmail.com
+**
+**  This program is under the terms of the BSD License.
+*/
+
+//Ponce
+#include "loop_detector.hpp"
+#include "globals.hpp"
+#include "solver_job.hpp"
+#include "engine_edits.hpp"
+
+bool LoopDetector::addBranch(ea_t source, ea_t target) {
+    if (target > source)
+        return false;
+    size_t iterations = ++this->back_edges[{ source, target }];
+    if (iterations != LOOP_HOT_ITERATIONS)
+        return false;
+    this->hot_loops.push_back({ source, target });
+    return true;
+}
+
+
+bool LoopDetector::isInHotLoop(ea_t address) const {
+    for (const auto& [source, target] : this->hot_loops) {
+        if (address >= target && address <= source)
+            return true;
+    }
+    return false;
+}
+
+
+size_t LoopDetector::getIterations(ea_t source, ea_t target) const {
+    auto it = this->back_edges.find({ source, target });
+    return it == this->back_edges.end() ? 0 : it->second;
+}
+
+
+void LoopDetector::reset(void) {
+    this->back_edges.clear();
+    this->hot_loops.clear();
+}
+
+
+/*The constraint of the previous iteration is implied by the last one when the induction variable is monotonic,
+which is the common case. When it is not, the solutions are only approximated, they are checked by running them anyway*/
+bool summarize_loop_constraint(ea_t pc)
+{
+    //The solver job reads the path constraints from its thread
+    if (!loop_detector.isInHotLoop(pc) || is_solver_job_running())
+        return false;
+
+    const auto& pathConstraints = api.getPathConstraints();
+    if (pathConstraints.size() < 2)
+        return false;
+
+    // The direction the last iteration took at this branch
+    const auto& last = pathConstraints.back();
+    if (last.getBranchConstraints().empty() || (ea_t)std::get<1>(last.getBranchConstraints()[0]) != pc)
+        return false;
+    triton::uint64 taken_target = last.getTakenAddress();
+
+    size_t first = pathConstraints.size() > LOOP_SUMMARY_LOOKBACK ? pathConstraints.size() - 1 - LOOP_SUMMARY_LOOKBACK : 0;
+    for (size_t i = pathConstraints.size() - 1; i-- > first;) {
+        const auto& previous = pathConstraints[i];
+        if (previous.getBranchConstraints().empty() || (ea_t)std::get<1>(previous.getBranchConstraints()[0]) != pc)
+            continue;
+        if (previous.getTakenAddress() != taken_target)
+            continue;
+        //The incremental solver notices the predicates that changed and asserts them again
+        erase_path_constraints(api, i, 1);
+        trace_recorder.recordErasePathConstraints(i, 1);
+        branch_index.removeConstraint(i, pc);
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,59 @@
+//! \file
+/*
+**  Copyright (c) 2020 - Ponce
+**  Authors:
+**         Alberto Garcia Illera        agarciaillera@gmail.com
+**         Francisco Oca                francisco.oca.gonzalez@gmail.com
+**
+**  This program is under the terms of the BSD License.
+*/
+
+/*Finds the loops in the traced instructions by counting their back-edges, the taken branches going back to a
+lower address. A loop iterated more than LOOP_HOT_ITERATIONS times is hot.
+A symbolic branch inside a hot loop adds the same constraint over the induction variable at every iteration
+(i < len, i + 1 < len...). When the loops are summarized only the constraint of the last iteration is kept for
+every branch and direction of a hot loop, so the path constraints stop growing with the number of iterations*/
+
+#pragma once
+
+#include <map>
+#include <utility>
+#include <vector>
+
+//IDA
+#include <pro.h>
+
+//Iterations of a loop before it is hot
+#define LOOP_HOT_ITERATIONS 16
+
+//Path constraints looked back for a previous iteration of the same branch
+#define LOOP_SUMMARY_LOOKBACK 64
+
+//! \class LoopDetector
+//! \brief Counts the iterations of every back-edge of the trace.
+class LoopDetector {
+
+private:
+    //! Iterations of every back-edge, by source and target address.
+    std::map<std::pair<ea_t, ea_t>, size_t> back_edges;
+
+    //! The back-edges of the hot loops, the loop body is between the target and the source.
+    std::vector<std::pair<ea_t, ea_t>> hot_loops;
+
+public:
+    //! Called for every taken branch. Returns true the first time the loop of the back-edge gets hot.
+    bool addBranch(ea_t source, ea_t target);
+
+    //! True if the address is in the body of a hot loop.
+    bool isInHotLoop(ea_t address) const;
+
+    //! Number of iterations of the back-edge.
+    size_t getIterations(ea_t source, ea_t target) const;
+
+    //! Forgets every loop, for a new trace.
+    void reset(void);
+};
+
+//Removes the path constraint of the previous iteration of the last path constraint if it was added by the branch at pc in a hot loop.
+//Returns true if one was removed
+bool summarize_loop_constraint(ea_t pc);
@@ -26,6 +26,7 @@
 #include "utils.hpp"
 #include "formConfiguration.hpp"
 #include "triton_logic.hpp"
+#include "solver_job.hpp"
 #include "actions.hpp"
 
 #ifdef BUILD_HEXRAYS_SUPPORT
@@ -110,6 +111,10 @@ bool idaapi run(size_t)
             warning("[!] Could not hook tracer callback");
             return false;
         }
+        if (!hook_to_notification_point(HT_IDB, idb_callback, NULL)) {
+            warning("[!] Could not hook idb callback");
+            return false;
+        }
 
         msg("[+] Ponce plugin running!\n");
         hooked = true;
@@ -178,6 +183,10 @@ void idaapi term(void)
 {
     // remove snapshot if exists
     snapshot.resetEngine();
+    // flush the trace being recorded
+    trace_recorder.stop();
+    // stop the solver running in background, its thread must be gone before the plugin is unloaded
+    stop_solver_job();
     // We want to delete Ponce comments and colours before terminating
     delete_ponce_comments();
 #ifdef BUILD_HEXRAYS_SUPPORT
@@ -186,6 +195,7 @@ void idaapi term(void)
     // Unhook notifications
     unhook_from_notification_point(HT_UI, ui_callback, NULL);
     unhook_from_notification_point(HT_DBG, tracer_callback, NULL);
+    unhook_from_notification_point(HT_IDB, idb_callback, NULL);
     // Unregister and detach menus
     unregister_action(action_IDA_show_config.name);
     detach_action_from_menu("Edit/Ponce/", action_IDA_show_config.name);
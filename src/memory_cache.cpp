@@ -0,0 +1,104 @@
+//! \file
+/*
+**  Copyright (c) 2020 - Ponce
+**  Authors:
+**         Alberto Garcia Illera        agarciaillera@gmail.com
+**         Francisco Oca                francisco.oca.gonzalez@gmail.com
+**
+**  This program is under the terms of the BSD License.
+*/
+
+#include <array>
+#include <cstring>
+
+//Ponce
+#include "memory_cache.hpp"
+
+//IDA
+#include <ida.hpp>
+#include <bytes.hpp>
+#include <dbg.hpp>
+
+/*The cache is invalidated on every debugger event, so in step tracing it only lives for one instruction.
+Small lines keep the read of a cold line close to the cost of the get_bytes it replaces, and the lines are
+preallocated and invalidated by bumping a generation so an invalidation does not free or clear anything*/
+#define MEMORY_LINE_SHIFT 6
+#define MEMORY_LINE_SIZE (1 << MEMORY_LINE_SHIFT)
+//Direct mapped, the line number modulo this is the slot
+#define MEMORY_CACHE_LINES 256
+
+struct memory_line_t {
+    //Line number (address >> MEMORY_LINE_SHIFT)
+    ea_t line = BADADDR;
+    //The line is valid only if it was read in the current generation
+    uint32 generation = 0;
+    //False if the line could not be read entirely (unmapped or guard pages)
+    bool readable = false;
+    uint8 data[MEMORY_LINE_SIZE];
+};
+
+std::array<memory_line_t, MEMORY_CACHE_LINES> memory_cache;
+uint32 memory_cache_generation = 1;
+
+/*Returns the line containing address, reading it from the debugger the first time it is touched in this generation.
+Returns nullptr if the line can not be read entirely*/
+static const uint8* get_cached_line(ea_t line)
+{
+    memory_line_t& slot = memory_cache[line % MEMORY_CACHE_LINES];
+    if (slot.generation == memory_cache_generation && slot.line == line)
+        return slot.readable ? slot.data : nullptr;
+
+    ea_t line_start = line << MEMORY_LINE_SHIFT;
+    //This is the way to force IDA to read the value from the debugger
+    //More info here: https://www.hex-rays.com/products/ida/support/sdkdoc/dbg_8hpp.html#ac67a564945a2c1721691aa2f657a908c
+    invalidate_dbgmem_contents(line_start, MEMORY_LINE_SIZE);
+    slot.line = line;
+    slot.generation = memory_cache_generation;
+    slot.readable = get_bytes(slot.data, MEMORY_LINE_SIZE, line_start, GMB_READALL, NULL) == MEMORY_LINE_SIZE;
+    return slot.readable ? slot.data : nullptr;
+}
+
+/*Reads debugger memory like get_bytes does, but every line is read from the debugger only once
+until the cache is invalidated. The process memory does not change while it is suspended,
+so Triton asking many times for the same stack slot or string only costs one debugger round trip.
+Returns the number of bytes read or -1 on error*/
+ssize_t ponce_get_bytes(void* buffer, size_t size, ea_t address)
+{
+    //A big read would cost a round trip per line, one get_bytes is cheaper
+    if (size > MEMORY_LINE_SIZE) {
+        invalidate_dbgmem_contents(address, size);
+        return get_bytes(buffer, size, address, GMB_READALL, NULL);
+    }
+
+    uint8* out = static_cast<uint8*>(buffer);
+    size_t done = 0;
+    while (done < size) {
+        ea_t ea = address + done;
+        size_t offset = ea & (MEMORY_LINE_SIZE - 1);
+        size_t chunk = qmin(size - done, (size_t)MEMORY_LINE_SIZE - offset);
+        const uint8* line = get_cached_line(ea >> MEMORY_LINE_SHIFT);
+        if (line != nullptr) {
+            memcpy(out + done, line + offset, chunk);
+        }
+        else {
+            //Partially readable line, let IDA handle it
+            invalidate_dbgmem_contents(ea, chunk);
+            if (get_bytes(out + done, chunk, ea, GMB_READALL, NULL) != (ssize_t)chunk)
+                return done == 0 ? -1 : (ssize_t)done;
+        }
+        done += chunk;
+    }
+    return (ssize_t)done;
+}
+
+/*The cache is only valid while the process is suspended and nobody writes to its memory.
+This is called on every debugger event and every time Ponce writes memory*/
+void invalidate_memory_cache()
+{
+    if (++memory_cache_generation == 0) {
+        //The generation wrapped around, an old line could look valid
+        for (auto& slot : memory_cache)
+            slot.generation = 0;
+        memory_cache_generation = 1;
+    }
+}
@@ -0,0 +1,16 @@
+//! \file
+/*
+**  Copyright (c) 2020 - Ponce
+**  Authors:
+**         Alberto Garcia Illera        agarciaillera@gmail.com
+**         Francisco Oca                francisco.oca.gonzalez@gmail.com
+**
+**  This program is under the terms of the BSD License.
+*/
+
+#pragma once
+//IDA
+#include <pro.h>
+
+ssize_t ponce_get_bytes(void* buffer, size_t size, ea_t address);
+void invalidate_memory_cache();
@@ -14,42 +14,65 @@
 
 #include <hexrays.hpp>
 
+#include <iterator>
+#include <map>
+#include <vector>
+
 bool hexrays_present = false;
 
-/* Returns the pseudocode line corresponding to an address or -1 if fail*/
-int get_compile_coord_by_ea(cfunc_t* cfunc, ea_t addr) {
-    int y = -1;
+//Pseudocode line of every item of a decompiled function, by address
+struct pseudocode_lines_t {
+    std::map<ea_t, int> lines;
+    //Number of lines when it was built. Collapsing a block changes the lines without decompiling again
+    size_t line_count = 0;
+};
+
+//The line maps of the functions printed, by entry address. They are built again when the function is decompiled
+static std::map<ea_t, pseudocode_lines_t> pseudocode_lines_cache;
+
+/* Builds the map from the items of the function to their pseudocode lines, only once per decompilation*/
+static const pseudocode_lines_t& get_pseudocode_lines(cfunc_t* cfunc) {
+    auto& cached = pseudocode_lines_cache[cfunc->entry_ea];
+    const strvec_t& pseudocode = cfunc->sv;
+    if (cached.line_count == pseudocode.size() && !cached.lines.empty())
+        return cached;
+
+    cached.lines.clear();
+    cached.line_count = pseudocode.size();
 #if IDA_SDK_VERSION >= 720
-    if (citem_t* item = cfunc->body.find_closest_addr(addr)) {
-        if (cfunc->find_item_coords(item, nullptr, &y)) {
-            //found
-        }
-        else
-            y = -1;
+    for (const citem_t* item : cfunc->treeitems) {
+        int y = -1;
+        if (item == nullptr || item->ea == BADADDR || !cfunc->find_item_coords(item, nullptr, &y) || y == -1)
+            continue;
+        //The first line wins like with find_closest_addr
+        cached.lines.insert({ item->ea, y });
     }
 #else
-    std::map<ea_t, int> lnmap;
     int i = 0;
-    y = -1;
-
-    for (const auto& line : cfunc->get_pseudocode()) {
+    for (const auto& line : pseudocode) {
         auto pitem = ctree_item_t();
         auto ret = cfunc->get_line_item(line.line.c_str(), 0, true, nullptr, &pitem, nullptr);
         if (ret && pitem.it) {
-            lnmap[pitem.it->ea] = i;
+            cached.lines[pitem.it->ea] = i;
         }
         i++;
     }
-    ea_t closest_ea = BADADDR;
-    for (const auto& [ea, line] : lnmap) {
-        if (closest_ea == BADADDR || abs(int(closest_ea - addr)) > abs(int(ea - addr))) {
-            closest_ea = ea;
-            y = lnmap[ea];
-        }
-    }
 #endif
-    return y;
+    return cached;
+}
 
+/* Returns the pseudocode line of the item closest to an address or -1 if fail*/
+int get_compile_coord_by_ea(const pseudocode_lines_t& pseudocode_lines, ea_t addr) {
+    const auto& lines = pseudocode_lines.lines;
+    if (lines.empty())
+        return -1;
+    auto next = lines.lower_bound(addr);
+    if (next == lines.end())
+        return std::prev(next)->second;
+    if (next->first == addr || next == lines.begin())
+        return next->second;
+    auto previous = std::prev(next);
+    return addr - previous->first <= next->first - addr ? previous->second : next->second;
 }
 
 #if IDA_SDK_VERSION == 700
@@ -62,6 +85,13 @@ ssize_t idaapi ponce_hexrays_callback(void*, hexrays_event_t event, va_list va)
     
     switch (event)
     {
+    case hxe_maturity:
+    {
+        //The function is being decompiled again, its lines will change
+        cfunc_t* cfunc = va_arg(va, cfunc_t*);
+        pseudocode_lines_cache.erase(cfunc->entry_ea);
+        break;
+    }
     case hxe_func_printed:
     {
         cfunc_t* cfunc = va_arg(va, cfunc_t*);
@@ -71,35 +101,35 @@ ssize_t idaapi ponce_hexrays_callback(void*, hexrays_event_t event, va_list va)
 #else
         func_t* func = cfunc->mba->get_curfunc();
 #endif
-        std::list<int> already_commented_lines;
-        for (const auto& [address, insinfo] : ponce_comments) {
-            if (func_contains(func, address)) {
-                y = get_compile_coord_by_ea(cfunc, address);
-                if (y == -1)
-                    continue;
-                if (!insinfo.comment.empty()) { //comment
-                    if (std::find(already_commented_lines.begin(), already_commented_lines.end(), y) != already_commented_lines.end()) {
-                        // We have already commented this line. Don't do it again
-                        continue;
-                    }
-                    cfunc->sv[y].line.cat_sprnt("\t\t\t" COLSTR("// %s", SCOLOR_NUMBER), insinfo.comment.c_str());
-                    already_commented_lines.push_back(y);
-                }
-                if (!insinfo.snapshot_comment.empty()) { //extra comment
-                    if (std::find(already_commented_lines.begin(), already_commented_lines.end(), y) != already_commented_lines.end()) {
-                        // We have already commented this line. Don't do it again
-                        continue;
-                    }
-                    cfunc->sv[y].line += "\t\t\t/*";
-                    cfunc->sv[y].line += insinfo.comment.c_str();
-                    cfunc->sv[y].line += "*/";
-                    already_commented_lines.push_back(y);
+        const pseudocode_lines_t& pseudocode_lines = get_pseudocode_lines(cfunc);
+        // One bit per pseudocode line, set when the line has a comment
+        std::vector<bool> already_commented_lines(cfunc->sv.size(), false);
+        ponce_comments.forEachInFunction(func, [&](ea_t address, const instruction_info& insinfo) {
+            y = get_compile_coord_by_ea(pseudocode_lines, address);
+            if (y == -1 || (size_t)y >= already_commented_lines.size())
+                return;
+            if (!insinfo.comment.empty()) { //comment
+                if (already_commented_lines[y]) {
+                    // We have already commented this line. Don't do it again
+                    return;
                 }
-                if (insinfo.color != DEFCOLOR && insinfo.color != cmdOptions.color_executed_instruction) { //color
-                    cfunc->sv[y].bgcolor = insinfo.color;
+                cfunc->sv[y].line.cat_sprnt("\t\t\t" COLSTR("// %s", SCOLOR_NUMBER), insinfo.comment.c_str());
+                already_commented_lines[y] = true;
+            }
+            if (!insinfo.snapshot_comment.empty()) { //extra comment
+                if (already_commented_lines[y]) {
+                    // We have already commented this line. Don't do it again
+                    return;
                 }
+                cfunc->sv[y].line += "\t\t\t/*";
+                cfunc->sv[y].line += insinfo.comment.c_str();
+                cfunc->sv[y].line += "*/";
+                already_commented_lines[y] = true;
+            }
+            if (insinfo.color != DEFCOLOR && insinfo.color != cmdOptions.color_executed_instruction) { //color
+                cfunc->sv[y].bgcolor = insinfo.color;
             }
-        }       
+        });
         break;
     }
     default:
@@ -0,0 +1,151 @@
+//! \file
+/*
+**  Copyright (c) 2020 - Ponce
+**  Authors:
+**         Alberto Garcia Illera        agarciaillera@gmail.com
+**         Francisco Oca                francisco.oca.gonzalez@gmail.com
+**
+**  This program is under the terms of the BSD License.
+*/
+
+#include <fstream>
+#include <sstream>
+
+#include "query_cache.hpp"
+
+//The version changes with the keys, the entries of an older version are not loaded
+#define QUERY_CACHE_MAGIC "PONCE_QUERY_CACHE 2"
+
+QueryCache::QueryCache() {
+    this->hits = 0;
+    this->misses = 0;
+}
+
+
+/*FNV-1 over the 512 bits parts*/
+triton::uint512 QueryCache::combine(const triton::uint512& hash, const triton::uint512& part) {
+    static const triton::uint512 fnv_prime = (triton::uint512(1) << 344) + (1 << 8) + 0x57;
+    return (hash ^ part) * fnv_prime;
+}
+
+
+/*Unlike the Triton structural hashes, the text keeps the order of the operands: bvsub(a, b) and bvsub(b, a) differ*/
+triton::uint512 QueryCache::hashText(const std::string& text) {
+    triton::uint512 hash = text.size();
+    for (size_t i = 0; i < text.size(); i += sizeof(triton::uint64)) {
+        triton::uint64 chunk = 0;
+        for (size_t j = i; j < text.size() && j < i + sizeof(triton::uint64); j++)
+            chunk |= (triton::uint64)(unsigned char)text[j] << ((j - i) * 8);
+        hash = combine(hash, chunk);
+    }
+    return hash;
+}
+
+
+void QueryCache::put(const triton::uint512& hash, const query_result_t& result) {
+    auto it = this->index.find(hash);
+    if (it != this->index.end()) {
+        it->second->second = result;
+        this->entries.splice(this->entries.begin(), this->entries, it->second);
+        return;
+    }
+
+    this->entries.emplace_front(hash, result);
+    this->index[hash] = this->entries.begin();
+    if (this->entries.size() > QUERY_CACHE_SIZE) {
+        this->index.erase(this->entries.back().first);
+        this->entries.pop_back();
+    }
+}
+
+
+bool QueryCache::lookup(const triton::uint512& hash, query_result_t& result) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    auto it = this->index.find(hash);
+    if (it == this->index.end()) {
+        this->misses++;
+        return false;
+    }
+    this->hits++;
+    this->entries.splice(this->entries.begin(), this->entries, it->second);
+    result = it->second->second;
+    return true;
+}
+
+
+void QueryCache::insert(const triton::uint512& hash, const query_result_t& result) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->put(hash, result);
+}
+
+
+void QueryCache::clear(void) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->entries.clear();
+    this->index.clear();
+    this->hits = 0;
+    this->misses = 0;
+}
+
+
+std::pair<size_t, size_t> QueryCache::getStats(void) const {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return { this->hits, this->misses };
+}
+
+
+/*One entry per line: the query hash, 0 for unsat or 1 and the number of variables for sat, then the id and the value
+of every variable. The numbers are in hex. The least recently used entries are first so loading them keeps the order*/
+bool QueryCache::load(const std::string& path) {
+    std::ifstream file(path);
+    std::string line;
+    if (!file.is_open() || !std::getline(file, line) || line != QUERY_CACHE_MAGIC)
+        return false;
+
+    std::lock_guard<std::mutex> lock(this->mutex);
+    while (std::getline(file, line)) {
+        std::istringstream fields(line);
+        fields >> std::hex;
+        triton::uint512 hash;
+        unsigned int sat = 0;
+        query_result_t result;
+        if (!(fields >> hash >> sat))
+            return false;
+        result.sat = sat != 0;
+        if (result.sat) {
+            size_t variables = 0;
+            if (!(fields >> variables))
+                return false;
+            for (size_t i = 0; i < variables; i++) {
+                triton::usize id;
+                triton::uint512 value;
+                if (!(fields >> id >> value))
+                    return false;
+                result.model.emplace_back(id, value);
+            }
+        }
+        this->put(hash, result);
+    }
+    return true;
+}
+
+
+bool QueryCache::save(const std::string& path) const {
+    std::ofstream file(path, std::ios::out | std::ios::trunc);
+    if (!file.is_open())
+        return false;
+
+    std::lock_guard<std::mutex> lock(this->mutex);
+    file << QUERY_CACHE_MAGIC << "\n" << std::hex;
+    for (auto it = this->entries.rbegin(); it != this->entries.rend(); ++it) {
+        const auto& [hash, result] = *it;
+        file << hash << " " << (result.sat ? 1 : 0);
+        if (result.sat) {
+            file << " " << result.model.size();
+            for (const auto& [id, value] : result.model)
+                file << " " << id << " " << value;
+        }
+        file << "\n";
+    }
+    return file.good();
+}
@@ -0,0 +1,89 @@
+//! \file
+/*
+**  Copyright (c) 2020 - Ponce
+**  Authors:
+**         Alberto Garcia Illera        agarciaillera@gmail.com
+**         Francisco Oca                francisco.oca.gonzalez@gmail.com
+**
+**  This program is under the terms of the BSD License.
+*/
+
+/*Solver results indexed by the hash of the SMT-LIB text of the query. Loops emit the same branch over and over
+and the users ask again for the same branch after restoring a snapshot, those queries are answered without Z3.
+It must not depend on IDA since it is shared with the offline tools*/
+
+#pragma once
+
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+//Triton
+#include <triton/api.hpp>
+
+//Entries kept in memory, the least recently used ones are dropped first
+#define QUERY_CACHE_SIZE 4096
+
+//A solver verdict. Only sat and unsat are cached, a timeout may have a different answer the next time
+struct query_result_t {
+    bool sat = false;
+    //Value of every symbolic variable in the model, by symbolic variable id
+    std::vector<std::pair<triton::usize, triton::uint512>> model;
+};
+
+//! \class QueryCache
+//! \brief LRU cache of solver verdicts. It can be saved to disk so the next session with the same binary reuses it.
+class QueryCache {
+
+private:
+    typedef std::list<std::pair<triton::uint512, query_result_t>> entries_t;
+
+    //! Most recently used first.
+    entries_t entries;
+
+    //! The entries by query hash.
+    std::map<triton::uint512, entries_t::iterator> index;
+
+    //! Several solvers can use the same cache from different threads.
+    mutable std::mutex mutex;
+
+    //! Number of queries answered from the cache.
+    size_t hits;
+
+    //! Number of queries not found.
+    size_t misses;
+
+    //! Adds or replaces an entry, the caller owns the lock.
+    void put(const triton::uint512& hash, const query_result_t& result);
+
+public:
+    //! Constructor.
+    QueryCache();
+
+    //! Combines the hashes of the parts of a query. The order matters.
+    static triton::uint512 combine(const triton::uint512& hash, const triton::uint512& part);
+
+    //! Hashes the text of a query or of a part of it.
+    static triton::uint512 hashText(const std::string& text);
+
+    //! Returns true and the result if the query is cached.
+    bool lookup(const triton::uint512& hash, query_result_t& result);
+
+    //! Caches the result of a query.
+    void insert(const triton::uint512& hash, const query_result_t& result);
+
+    //! Deletes every entry.
+    void clear(void);
+
+    //! Returns the number of queries answered from the cache and the number of queries not found.
+    std::pair<size_t, size_t> getStats(void) const;
+
+    //! Adds the entries saved in a file. Returns false if it can not be read.
+    bool load(const std::string& path);
+
+    //! Saves every entry to a file. Returns false if it can not be written.
+    bool save(const std::string& path) const;
+};
@@ -0,0 +1,74 @@
+//! \file
+/*
+**  Copyright (c) 2020 - Ponce
+**  Authors:
+**         Alberto Garcia Illera        agarciaillera@gmail.com
+**         Francisco Oca                francisco.oca.gonzalez@gmail.com
+**
+**  This program is under the terms of the BSD License.
+*/
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+#include "query_corpus.hpp"
+
+bool QueryCorpus::open(const std::string& directory) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    if (!std::filesystem::is_directory(directory, error)) {
+        this->directory.clear();
+        return false;
+    }
+    this->directory = directory;
+
+    //The corpus can be extended by several sessions, the queries they indexed are not indexed again
+    this->indexed.clear();
+    std::ifstream index(std::filesystem::path(directory) / QUERY_CORPUS_INDEX);
+    std::string line;
+    while (std::getline(index, line)) {
+        auto comma = line.find(',');
+        if (comma != std::string::npos)
+            this->indexed.insert(line.substr(0, comma));
+    }
+    return true;
+}
+
+
+void QueryCorpus::close(void) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->directory.clear();
+    this->indexed.clear();
+}
+
+
+bool QueryCorpus::isOpen(void) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return !this->directory.empty();
+}
+
+
+void QueryCorpus::add(const triton::uint512& hash, const std::string& smt2, const char* verdict, double milliseconds, triton::uint64 srcAddr, triton::uint64 dstAddr) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (this->directory.empty())
+        return;
+
+    // The low 128 bits of the hash are enough to name the file
+    std::stringstream name;
+    name << std::hex << (hash & ((triton::uint512(1) << 128) - 1)) << ".smt2";
+    if (!this->indexed.insert(name.str()).second)
+        return;
+    std::filesystem::path path = std::filesystem::path(this->directory) / name.str();
+
+    std::error_code error;
+    if (!std::filesystem::exists(path, error)) {
+        std::ofstream query(path);
+        query << smt2;
+    }
+
+    std::filesystem::path index_path = std::filesystem::path(this->directory) / QUERY_CORPUS_INDEX;
+    std::ofstream index(index_path, std::ios::app);
+    index << name.str() << "," << verdict << "," << milliseconds << "," << std::hex << "0x" << srcAddr << ",0x" << dstAddr << "\n";
+}
@@ -0,0 +1,51 @@
+//! \file
+/*
+**  Copyright (c) 2020 - Ponce
+**  Authors:
+**         Alberto Garcia Illera        agarciaillera@gmail.com
+**         Francisco Oca                francisco.oca.gonzalez@gmail.com
+**
+**  This program is under the terms of the BSD License.
+*/
+
+/*Writes the solver queries to a directory as SMT-LIB files, with an index of their verdicts and solve times.
+ponce-bench solves them again to track the solver performance.
+It must not depend on IDA since it is shared with the offline tools*/
+
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <unordered_set>
+
+//Triton
+#include <triton/api.hpp>
+
+//Name of the index in the corpus directory. Every line is: file,verdict,milliseconds,source address,target address
+#define QUERY_CORPUS_INDEX "index.csv"
+
+//! \class QueryCorpus
+//! \brief A directory of SMT-LIB queries. The files are named after the query hash so the same query is only written once.
+class QueryCorpus {
+
+private:
+    //! Where the queries are written, empty if the corpus is not open.
+    std::string directory;
+
+    //! Files already in the index, loaded when the corpus is opened. A query is only indexed the first time it is solved.
+    std::unordered_set<std::string> indexed;
+
+    //! Queries are added from several solver threads.
+    std::mutex mutex;
+
+public:
+    //! Creates the directory if needed. Returns false if it can not be created.
+    bool open(const std::string& directory);
+
+    void close(void);
+
+    bool isOpen(void);
+
+    //! Writes a query and adds it to the index if it is not there yet.
+    void add(const triton::uint512& hash, const std::string& smt2, const char* verdict, double milliseconds, triton::uint64 srcAddr, triton::uint64 dstAddr);
+};
@@ -0,0 +1,130 @@
+//! \file
+/*
+**  Copyright (c) 2020 - Ponce
+**  Authors:
+**         Alberto Garcia Illera        agarciaillera@gmail.com
+**         Francisco Oca                francisco.oca.gonzalez@gmail.com
+**
+**  This program is under the terms of the BSD License.
+*/
+
+/*ponce-bench solves again the queries exported by Ponce (see query_corpus.hpp) and compares the verdicts and
+solve times with the ones recorded. It is used to track the solver performance on real queries.
+A verdict different from the recorded one is an error, sat and unsat can not change.
+
+Usage: ponce-bench [--timeout ms] [--strategy smt|qfbv|bit-blast|portfolio] corpus_directory*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+//Ponce
+#include "../query_corpus.hpp"
+#include "../solver_portfolio.hpp"
+
+typedef std::chrono::steady_clock bench_clock;
+
+static const char* verdict_name(z3::check_result verdict)
+{
+    return verdict == z3::sat ? "sat" : verdict == z3::unsat ? "unsat" : "unknown";
+}
+
+/*Returns the verdict of a query file with the strategy*/
+static z3::check_result solve_query(const std::string& path, const std::string& strategy, unsigned int timeout_ms)
+{
+    z3::context ctx;
+    z3::expr_vector query = ctx.parse_file(path.c_str());
+    if (strategy == "portfolio") {
+        SolverPortfolio portfolio;
+        return portfolio.solve(ctx, query, timeout_ms).verdict;
+    }
+
+    z3::solver solver = SolverPortfolio::makeSolver(ctx, strategy);
+    if (timeout_ms) {
+        z3::params params(ctx);
+        params.set("timeout", timeout_ms);
+        solver.set(params);
+    }
+    solver.add(query);
+    return solver.check();
+}
+
+int main(int argc, char* argv[])
+{
+    unsigned int timeout_ms = 0;
+    std::string strategy = "smt";
+    const char* directory = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--timeout") == 0 && i + 1 < argc)
+            timeout_ms = (unsigned int)strtoul(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--strategy") == 0 && i + 1 < argc)
+            strategy = argv[++i];
+        else
+            directory = argv[i];
+    }
+
+    const auto& strategies = SolverPortfolio::getStrategies();
+    bool known_strategy = strategy == "portfolio" || std::find(strategies.begin(), strategies.end(), strategy) != strategies.end();
+    if (!known_strategy)
+        printf("[!] Unknown strategy %s\n", strategy.c_str());
+
+    if (!directory || !known_strategy) {
+        printf("Usage: %s [--timeout ms] [--strategy smt|qfbv|bit-blast|portfolio] corpus_directory\n", argv[0]);
+        return 2;
+    }
+
+    std::string index_path = std::string(directory) + "/" + QUERY_CORPUS_INDEX;
+    std::ifstream index(index_path);
+    if (!index.is_open()) {
+        printf("[!] %s not found\n", index_path.c_str());
+        return 2;
+    }
+
+    size_t queries = 0, mismatches = 0, unknowns = 0;
+    double recorded_total = 0, total = 0;
+    std::string line;
+    while (std::getline(index, line)) {
+        // file,verdict,milliseconds,source address,target address
+        std::stringstream fields(line);
+        std::string file, recorded_verdict, recorded_ms;
+        if (!std::getline(fields, file, ',') || !std::getline(fields, recorded_verdict, ',') || !std::getline(fields, recorded_ms, ','))
+            continue;
+
+        z3::check_result verdict;
+        auto start = bench_clock::now();
+        try {
+            verdict = solve_query(std::string(directory) + "/" + file, strategy, timeout_ms);
+        }
+        catch (const z3::exception& e) {
+            printf("[!] %s: %s\n", file.c_str(), e.msg());
+            continue;
+        }
+        double milliseconds = std::chrono::duration<double, std::milli>(bench_clock::now() - start).count();
+
+        queries++;
+        recorded_total += atof(recorded_ms.c_str());
+        total += milliseconds;
+        if (verdict == z3::unknown)
+            unknowns++;
+        bool mismatch = verdict != z3::unknown && recorded_verdict != "unknown" && recorded_verdict != verdict_name(verdict);
+        if (mismatch)
+            mismatches++;
+        printf("%s %s %s: %s (recorded %s) %.3f ms (recorded %s ms)\n",
+            mismatch ? "[!]" : "[+]",
+            file.c_str(),
+            strategy.c_str(),
+            verdict_name(verdict),
+            recorded_verdict.c_str(),
+            milliseconds,
+            recorded_ms.c_str());
+    }
+
+    printf("[+] %zu queries solved with %s in %.3f ms (recorded %.3f ms), %zu unknown, %zu different verdicts\n",
+        queries, strategy.c_str(), total, recorded_total, unknowns, mismatches);
+    return mismatches ? 1 : 0;
+}
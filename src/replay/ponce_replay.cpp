@@ -0,0 +1,298 @@
+//! \file
+/*
+**  Copyright (c) 2020 - Ponce
+**  Authors:
+**         Alberto Garcia Illera        agarciaillera@gmail.com
+**         Francisco Oca                francisco.oca.gonzalez@gmail.com
+**
+**  This program is under the terms of the BSD License.
+*/
+
+/*ponce-replay replays the traces recorded by Ponce (see trace_format.hpp) without IDA.
+Every instruction goes through Triton with the concrete values read from the debugger while recording,
+so the symbolic expressions and path constraints are the same ones Ponce built. Then it solves every
+non taken branch like the "Solve formula" action does.
+The changes Ponce did to the engines between instructions (skipped and summarized calls, garbage collection, loop summaries)
+are done again. The traces with an injected solution or a restored snapshot are refused, their path constraints would not be
+the ones Ponce solved.
+
+Usage: ponce-replay [--no-solve] [--batch] [--portfolio] [--export corpus_directory] trace1.ptrace [trace2.ptrace ...]*/
+
+#include <chrono>
+#include <cstdio>
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+//Triton
+#include <triton/api.hpp>
+
+//Ponce
+#include "../trace_format.hpp"
+#include "../engine_edits.hpp"
+#include "../incremental_solver.hpp"
+#include "../batch_solver.hpp"
+#include "../query_corpus.hpp"
+
+typedef std::chrono::steady_clock replay_clock;
+
+/*Configures Triton like triton_restart_engines() does, using the configuration saved in the trace*/
+static void setup_engines(triton::API& api, triton::uint8 architecture, triton::uint8 flags)
+{
+    bool use_tainting_engine = (flags & TRACE_FLAG_TAINT_ENGINE) != 0;
+
+    api.setArchitecture((triton::arch::architecture_e)architecture);
+    api.getTaintEngine()->enable(use_tainting_engine);
+    api.getSymbolicEngine()->enable(true);
+
+    api.setMode(triton::modes::ALIGNED_MEMORY, true);
+    api.setMode(triton::modes::ONLY_ON_SYMBOLIZED, !use_tainting_engine);
+    api.setMode(triton::modes::ONLY_ON_TAINTED, use_tainting_engine);
+    api.setMode(triton::modes::PC_TRACKING_SYMBOLIC, true);
+
+    api.setMode(triton::modes::AST_OPTIMIZATIONS, (flags & TRACE_FLAG_AST_OPTIMIZATIONS) != 0);
+    api.setMode(triton::modes::CONCRETIZE_UNDEFINED_REGISTERS, (flags & TRACE_FLAG_CONCRETIZE_UNDEFINED_REGISTERS) != 0);
+    api.setMode(triton::modes::CONSTANT_FOLDING, (flags & TRACE_FLAG_CONSTANT_FOLDING) != 0);
+    api.setMode(triton::modes::SYMBOLIZE_INDEX_ROTATION, (flags & TRACE_FLAG_SYMBOLIZE_INDEX_ROTATION) != 0);
+    api.setMode(triton::modes::TAINT_THROUGH_POINTERS, (flags & TRACE_FLAG_TAINT_THROUGH_POINTERS) != 0);
+}
+
+/*Symbolizes or taints what the user selected while recording (Ponce does it byte by byte) or does what Ponce did to the engines*/
+static void apply_edit(triton::API& api, const trace_record_t& record, bool use_tainting_engine)
+{
+    switch (record.type) {
+    case TRACE_TAG_CONCRETIZE_REGISTER:
+    {
+        auto reg = api.getRegister((triton::arch::register_e)record.register_id);
+        api.concretizeRegister(reg);
+        api.untaintRegister(reg);
+        return;
+    }
+    case TRACE_TAG_CONCRETIZE_MEMORY:
+        for (triton::uint32 i = 0; i < record.size; i++)
+            api.concretizeMemory(record.address + i);
+        return;
+    case TRACE_TAG_SUMMARY:
+        apply_summary_effect(api, record.effect);
+        return;
+    case TRACE_TAG_ERASE_CONSTRAINTS:
+        erase_path_constraints(api, (size_t)record.address, record.size);
+        return;
+    default:
+        break;
+    }
+
+    if (record.type == TRACE_TAG_SYMBOLIZE_MEMORY) {
+        for (triton::uint32 i = 0; i < record.size; i++) {
+            auto mem = triton::arch::MemoryAccess(record.address + i, 1);
+            if (use_tainting_engine)
+                api.taintMemory(mem);
+            else
+                api.symbolizeMemory(mem);
+        }
+    }
+    else {
+        auto reg = api.getRegister((triton::arch::register_e)record.register_id);
+        if (use_tainting_engine)
+            api.taintRegister(reg);
+        else
+            api.symbolizeRegister(reg);
+    }
+}
+
+/*Returns false if the instruction is not supported by Triton*/
+static bool process(triton::API& api, const trace_record_t& record)
+{
+    triton::arch::Instruction instruction;
+    instruction.setOpcode(record.opcodes, record.size);
+    instruction.setAddress(record.address);
+    instruction.setThreadId(record.thread_id);
+    try {
+        return api.processing(instruction);
+    }
+    catch (const triton::exceptions::Exception&) {
+        return false;
+    }
+}
+
+/*Solves every non taken branch of the path constraints. Returns the number of queries*/
+static size_t solve_path_constraints(triton::API& api, bool portfolio, QueryCorpus* corpus)
+{
+    // Loops emit the same branch again and again, those queries are answered by the cache
+    QueryCache cache;
+    IncrementalSolver solver(&cache);
+    solver.setPortfolio(portfolio);
+    solver.setCorpus(corpus);
+    size_t queries = 0;
+    size_t path_constraints = api.getPathConstraints().size();
+    for (size_t index = 0; index < path_constraints; index++) {
+        for (const auto& [srcAddr, dstAddr, model] : solver.solve(api, index)) {
+            queries++;
+            if (model.empty()) {
+                printf("[!] [%zu] %#llx -> %#llx: no solution found\n", index, (unsigned long long)srcAddr, (unsigned long long)dstAddr);
+                continue;
+            }
+            printf("[+] [%zu] %#llx -> %#llx: solution found\n", index, (unsigned long long)srcAddr, (unsigned long long)dstAddr);
+            for (const auto& [symId, solverModel] : model) {
+                printf(" - %s: %#llx\n", solverModel.getVariable()->getName().c_str(), (unsigned long long)solverModel.getValue().convert_to<triton::uint64>());
+            }
+        }
+    }
+    auto [hits, misses] = cache.getStats();
+    printf("[+] %zu queries answered by the cache\n", hits);
+    return queries;
+}
+
+/*Solves every non taken branch at once with a thread per core and prints the new inputs ranked. Returns the number of inputs*/
+static size_t solve_all_path_constraints(triton::API& api)
+{
+    QueryCache cache;
+    auto inputs = solve_all_branches(api, std::max(1u, std::thread::hardware_concurrency()), nullptr, &cache);
+    size_t rank = 1;
+    for (const auto& input : inputs) {
+        printf("[+] #%zu [%zu] %#llx -> %#llx%s\n", rank++, input.path_constraint_index, (unsigned long long)input.srcAddr, (unsigned long long)input.dstAddr, input.new_target ? " reaches new code" : "");
+        for (const auto& [symId, solverModel] : input.model) {
+            printf(" - %s: %#llx\n", solverModel.getVariable()->getName().c_str(), (unsigned long long)solverModel.getValue().convert_to<triton::uint64>());
+        }
+    }
+    return inputs.size();
+}
+
+/*Returns false if the trace can not be replayed*/
+static bool replay(const char* path, bool solve, bool batch, bool portfolio, QueryCorpus* corpus)
+{
+    TraceReader reader;
+    if (!reader.open(path)) {
+        printf("[!] %s is not a valid Ponce trace\n", path);
+        return false;
+    }
+
+    triton::API api;
+    bool use_tainting_engine = (reader.getFlags() & TRACE_FLAG_TAINT_ENGINE) != 0;
+    try {
+        setup_engines(api, reader.getArchitecture(), reader.getFlags());
+    }
+    catch (const triton::exceptions::Exception& e) {
+        printf("[!] %s: unsupported architecture (%s)\n", path, e.what());
+        return false;
+    }
+
+    /*The values read while processing an instruction are recorded after it, so we keep it pending until
+    the next instruction and set the recorded values before processing it.
+    The symbolizations and the engine edits are recorded before the values they need, so they are applied in order just before the next instruction*/
+    trace_record_t record, pending_instruction;
+    bool has_pending_instruction = false;
+    std::vector<trace_record_t> pending_edits;
+    triton::uint64 instructions = 0, unsupported = 0;
+
+    auto start = replay_clock::now();
+    while (reader.next(record)) {
+        switch (record.type) {
+        case TRACE_TAG_INSTRUCTION:
+            if (has_pending_instruction) {
+                unsupported += process(api, pending_instruction) ? 0 : 1;
+                instructions++;
+            }
+            for (const auto& edit : pending_edits)
+                apply_edit(api, edit, use_tainting_engine);
+            pending_edits.clear();
+            pending_instruction = record;
+            has_pending_instruction = true;
+            break;
+        case TRACE_TAG_MEMORY:
+            api.setConcreteMemoryValue(triton::arch::MemoryAccess(record.address, record.size), record.value);
+            break;
+        case TRACE_TAG_REGISTER:
+            api.setConcreteRegisterValue(api.getRegister((triton::arch::register_e)record.register_id), record.value);
+            break;
+        case TRACE_TAG_SYMBOLIZE_MEMORY:
+        case TRACE_TAG_SYMBOLIZE_REGISTER:
+        case TRACE_TAG_CONCRETIZE_REGISTER:
+        case TRACE_TAG_CONCRETIZE_MEMORY:
+        case TRACE_TAG_SUMMARY:
+        case TRACE_TAG_ERASE_CONSTRAINTS:
+            if (has_pending_instruction) {
+                unsupported += process(api, pending_instruction) ? 0 : 1;
+                instructions++;
+                has_pending_instruction = false;
+            }
+            pending_edits.push_back(record);
+            break;
+        case TRACE_TAG_ENGINE_EDIT:
+            printf("[!] %s is not replayable: %s after %llu instructions\n", path, trace_edit_name(record.edit), (unsigned long long)instructions);
+            return false;
+        default:
+            break;
+        }
+    }
+    if (has_pending_instruction) {
+        unsupported += process(api, pending_instruction) ? 0 : 1;
+        instructions++;
+    }
+    for (const auto& edit : pending_edits)
+        apply_edit(api, edit, use_tainting_engine);
+
+    double replay_seconds = std::chrono::duration<double>(replay_clock::now() - start).count();
+    if (reader.isCorrupted())
+        printf("[!] %s is truncated or corrupted, replayed up to the last valid record\n", path);
+
+    printf("[+] %s: %llu instructions (%llu not supported by Triton) in %.3f s, %.0f instructions/s\n",
+        path,
+        (unsigned long long)instructions,
+        (unsigned long long)unsupported,
+        replay_seconds,
+        replay_seconds > 0 ? instructions / replay_seconds : 0.0);
+    printf("[+] %s: %zu symbolic variables, %zu path constraints\n", path, api.getSymbolicVariables().size(), api.getPathConstraints().size());
+
+    if (solve && batch) {
+        start = replay_clock::now();
+        size_t inputs = solve_all_path_constraints(api);
+        double solve_seconds = std::chrono::duration<double>(replay_clock::now() - start).count();
+        printf("[+] %s: %zu new inputs in %.3f s\n", path, inputs, solve_seconds);
+    }
+    else if (solve) {
+        start = replay_clock::now();
+        size_t queries = solve_path_constraints(api, portfolio, corpus);
+        double solve_seconds = std::chrono::duration<double>(replay_clock::now() - start).count();
+        printf("[+] %s: %zu queries in %.3f s, %.1f queries/s\n", path, queries, solve_seconds, solve_seconds > 0 ? queries / solve_seconds : 0.0);
+    }
+    return !reader.isCorrupted();
+}
+
+int main(int argc, char* argv[])
+{
+    bool solve = true;
+    bool batch = false;
+    bool portfolio = false;
+    QueryCorpus corpus;
+    std::vector<const char*> traces;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--no-solve") == 0)
+            solve = false;
+        else if (strcmp(argv[i], "--batch") == 0)
+            batch = true;
+        else if (strcmp(argv[i], "--portfolio") == 0)
+            portfolio = true;
+        else if (strcmp(argv[i], "--export") == 0 && i + 1 < argc) {
+            if (!corpus.open(argv[++i])) {
+                printf("[!] %s can not be created\n", argv[i]);
+                return 2;
+            }
+        }
+        else
+            traces.push_back(argv[i]);
+    }
+
+    if (traces.empty()) {
+        printf("Usage: %s [--no-solve] [--batch] [--portfolio] [--export corpus_directory] trace1.ptrace [trace2.ptrace ...]\n", argv[0]);
+        return 2;
+    }
+
+    int ret = 0;
+    for (const auto& trace : traces) {
+        if (!replay(trace, solve, batch, portfolio, corpus.isOpen() ? &corpus : nullptr))
+            ret = 1;
+    }
+    return ret;
+}
@@ -34,6 +34,7 @@ typedef struct runtime_status_t
     //Trigger to enable/disable triton
     Trigger runtimeTrigger;
     //This is the last instruction executed by triton, we need to reference to reanalize if the user taint a register
+    //It is borrowed from the instruction_pool, never delete it
     triton::arch::Instruction* last_triton_instruction;
     //This variable is used to know how much time the tracing was working, and stop if this time is bigger than the user defined value
     std::uint64_t tracing_start_time = 0;
@@ -5,20 +5,61 @@
 **  This program is under the terms of the BSD License.
 */
 
+#include <algorithm>
+#include <cstring>
 #include <iostream>
+#include <iterator>
 
 #include "snapshot.hpp"
 #include "globals.hpp"
 #include "utils.hpp"
+#include "instruction_cache.hpp"
+#include "memory_cache.hpp"
+#include "context.hpp"
+#include "solver_job.hpp"
 
 #include "dbg.hpp"
 
+/* Add the original content of a written range. Only the first write to every byte is kept,
+and the range is merged with the overlapping and adjacent runs so restoring needs few writes. */
+static void add_memory_run(memory_runs_t& memory, ea_t address, const uint8* bytes, size_t size) {
+    if (size == 0)
+        return;
+
+    ea_t end = address + size;
+    // First run that could overlap or be adjacent to the range
+    auto it = memory.upper_bound(address);
+    if (it != memory.begin()) {
+        auto prev = std::prev(it);
+        if (prev->first + prev->second.size() >= address)
+            it = prev;
+    }
+
+    // Most of the writes (stack, loops) go to memory we already saved
+    if (it != memory.end() && it->first <= address && it->first + it->second.size() >= end)
+        return;
+
+    ea_t run_start = (it != memory.end() && it->first < address) ? it->first : address;
+    ea_t run_end = end;
+    auto last = it;
+    for (; last != memory.end() && last->first <= end; ++last)
+        run_end = std::max(run_end, (ea_t)(last->first + last->second.size()));
+
+    std::vector<uint8> run(run_end - run_start);
+    memcpy(run.data() + (address - run_start), bytes, size);
+    // The bytes already saved are older, they win
+    for (auto i = it; i != last; ++i)
+        memcpy(run.data() + (i->first - run_start), i->second.data(), i->second.size());
+
+    memory.erase(it, last);
+    memory.emplace(run_start, std::move(run));
+}
+
+
 Snapshot::Snapshot() {
     this->locked = true;
-    this->snapshotTaintEngine = nullptr;
-    this->snapshotSymEngine = nullptr;
     this->mustBeRestore = false;
-    this->snapshotTaken = false;
+    this->current = -1;
 }
 
 
@@ -27,103 +68,178 @@ Snapshot::~Snapshot() {
 
 /* Check if the snapshot has been taken */
 bool Snapshot::exists(void) {
-    return this->snapshotTaken;
+    return !this->snapshots.empty();
 }
 
-/* Add the modification byte. */
-void Snapshot::addModification(ea_t mem, char byte) {
-    if (this->locked == false && this->memory.find(mem) == this->memory.end())
-        this->memory[mem] = byte;
+/* Add the modification. We save the content before the write the first time every byte is written after the current snapshot */
+void Snapshot::addModification(ea_t address, const uint8* bytes, size_t size) {
+    if (!this->locked)
+        add_memory_run(this->memory, address, bytes, size);
 }
 
 
-/* Enable the snapshot engine. */
-void Snapshot::takeSnapshot() {
-    this->snapshotTaken = true;
+/* Take a snapshot as a child of the current one. Only what changed since the current one is saved for the debugger state. */
+size_t Snapshot::takeSnapshot(const std::string& name, ea_t address) {
+    snapshot_node_t node;
+    node.name = name;
+    node.address = address;
+    node.parent = this->current;
+    node.depth = this->current >= 0 ? this->snapshots[this->current].depth + 1 : 0;
 
-    /* 1 - Unlock the engine */
-    this->locked = false;
+    /* 1 - Save the memory written since the parent, before and after */
+    node.old_memory = std::move(this->memory);
+    this->memory.clear();
+    for (const auto& [run_start, run] : node.old_memory) {
+        std::vector<uint8> content(run.size());
+        if (ponce_get_bytes(content.data(), content.size(), run_start) != (ssize_t)content.size())
+            msg("[!] Error reading memory from " MEM_FORMAT "\n", run_start);
+        node.new_memory.emplace(run_start, std::move(content));
+    }
 
     /* 2 - Save current symbolic engine state */
-    this->snapshotSymEngine = new triton::engines::symbolic::SymbolicEngine(*api.getSymbolicEngine());
+    node.triton_state.symEngine = std::make_shared<triton::engines::symbolic::SymbolicEngine>(*api.getSymbolicEngine());
 
     /* 3 - Save current taint engine state */
-    this->snapshotTaintEngine = new triton::engines::taint::TaintEngine(*api.getTaintEngine());
+    node.triton_state.taintEngine = std::make_shared<triton::engines::taint::TaintEngine>(*api.getTaintEngine());
 
     /* 4 - Save current set of nodes */
-    this->astCtx = new triton::ast::AstContext(*api.getAstContext());
-    //this->nodesList = api.getAllocatedAstNodes();
+    node.triton_state.astCtx = std::make_shared<triton::ast::AstContext>(*api.getAstContext());
 
     /* 5 - Save the Triton CPU state. It depens on the analyzed binary*/   
     switch (api.getArchitecture()) {
     case triton::arch::ARCH_X86_64:
-        this->cpu_x8664 = new triton::arch::x86::x8664Cpu(*dynamic_cast<triton::arch::x86::x8664Cpu*>(api.getCpuInstance()));
+        node.triton_state.cpu_x8664 = std::make_shared<triton::arch::x86::x8664Cpu>(*dynamic_cast<triton::arch::x86::x8664Cpu*>(api.getCpuInstance()));
         break;
     case triton::arch::ARCH_X86:
-        this->cpu_x86 = new triton::arch::x86::x86Cpu(*reinterpret_cast<triton::arch::x86::x86Cpu*>(api.getCpuInstance()));
+        node.triton_state.cpu_x86 = std::make_shared<triton::arch::x86::x86Cpu>(*reinterpret_cast<triton::arch::x86::x86Cpu*>(api.getCpuInstance()));
         break;
     case triton::arch::ARCH_AARCH64:
-        this->cpu_AArch64 = new triton::arch::arm::aarch64::AArch64Cpu(*reinterpret_cast<triton::arch::arm::aarch64::AArch64Cpu*>(api.getCpuInstance()));
+        node.triton_state.cpu_AArch64 = std::make_shared<triton::arch::arm::aarch64::AArch64Cpu>(*reinterpret_cast<triton::arch::arm::aarch64::AArch64Cpu*>(api.getCpuInstance()));
         break;
     case triton::arch::ARCH_ARM32:
-        this->cpu_Arm32 = new triton::arch::arm::arm32::Arm32Cpu(*reinterpret_cast<triton::arch::arm::arm32::Arm32Cpu*>(api.getCpuInstance()));
+        node.triton_state.cpu_Arm32 = std::make_shared<triton::arch::arm::arm32::Arm32Cpu>(*reinterpret_cast<triton::arch::arm::arm32::Arm32Cpu*>(api.getCpuInstance()));
         break;
     default:
         throw triton::exceptions::Architecture("Architecture not supported.");
         break;
     }
 
-    /* 6 - Save IDA registers context */
-    auto regs = api.getAllRegisters();
-    for (auto it = regs.begin(); it != regs.end(); it++)
-    {
-        const triton::arch::Register reg = (*it).second;
+    /* 6 - Save the IDA registers that changed since the parent */
+    auto parent_registers = this->getRegisters(this->current);
+    for (const auto& [id, reg] : api.getAllRegisters()) {
         uint64 ival;
         if (get_reg_val(reg.getName().c_str(), &ival)) {
-            this->IDAContext[reg.getName()] = ival;
+            auto it = parent_registers.find(reg.getName());
+            if (it == parent_registers.end() || it->second != ival)
+                node.registers[reg.getName()] = ival;
         }
     }
 
     //We also saved the ponce status
-    this->saved_ponce_runtime_status = ponce_runtime_status;
+    node.path_constraints = api.getPathConstraints().size();
+    node.saved_ponce_runtime_status = ponce_runtime_status;
+
+    this->snapshots.push_back(std::move(node));
+    this->current = this->snapshots.size() - 1;
+    this->locked = false;
+
+    std::string comment = "Snapshot " + name + " taken here";
+    ponce_set_cmt(address, comment.c_str(), false, true);
+    ponce_set_item_color(address, 0x00FFFF);
+    flush_annotations();
+
+    return (size_t)this->current;
+}
+
+
+/* Returns every register of a snapshot applying the differences from the first snapshot down to it */
+std::map<std::string, triton::uint512> Snapshot::getRegisters(ssize_t id) const {
+    std::vector<ssize_t> path;
+    for (; id >= 0; id = this->snapshots[id].parent)
+        path.push_back(id);
+
+    std::map<std::string, triton::uint512> registers;
+    for (auto it = path.rbegin(); it != path.rend(); ++it) {
+        for (const auto& [name, value] : this->snapshots[*it].registers)
+            registers[name] = value;
+    }
+    return registers;
 }
 
-void Snapshot::setAddress(ea_t address) {
-    this->address = address;
+
+void Snapshot::writeMemory(const memory_runs_t& runs) const {
+    for (const auto& [run_start, run] : runs) {
+        put_bytes(run_start, run.data(), run.size());
+        invalidate_instruction_cache(run_start, run.size());
+    }
 }
 
 
-/* Restore the snapshot. */
+/* Restore the current snapshot. */
 void Snapshot::restoreSnapshot() {
+    if (this->current >= 0)
+        this->restoreSnapshot((size_t)this->current);
+}
 
-    /* 1 - Restore all memory modification. */
-    for (auto i = this->memory.begin(); i != this->memory.end(); ++i) {
-        put_bytes(i->first, &i->second, 1);
-    }
+
+/* Restore any snapshot of the tree. */
+void Snapshot::restoreSnapshot(size_t id) {
+    if (id >= this->snapshots.size())
+        return;
+
+    //The solver job reads the engine we are about to change
+    stop_solver_job();
+    trace_recorder.recordEngineEdit(TRACE_EDIT_RESTORE_SNAPSHOT);
+
+    /* 1 - Undo the memory modifications done since the current snapshot */
+    this->writeMemory(this->memory);
     this->memory.clear();
 
-    /* 2 - Restore current symbolic engine state */
-    *api.getSymbolicEngine() = *this->snapshotSymEngine;
+    /* 2 - Walk the tree from the current snapshot to the target through their common ancestor.
+    Going up we write the content of every snapshot parent, going down the content of every snapshot */
+    ssize_t from = this->current;
+    ssize_t to = (ssize_t)id;
+    std::vector<ssize_t> down;
+    while (from != to) {
+        if (from >= 0 && (to < 0 || this->snapshots[from].depth >= this->snapshots[to].depth)) {
+            this->writeMemory(this->snapshots[from].old_memory);
+            from = this->snapshots[from].parent;
+        }
+        else {
+            down.push_back(to);
+            to = this->snapshots[to].parent;
+        }
+    }
+    for (auto it = down.rbegin(); it != down.rend(); ++it)
+        this->writeMemory(this->snapshots[*it].new_memory);
+    invalidate_memory_cache();
+
+    const snapshot_node_t& node = this->snapshots[id];
 
-    /* 3 - Restore current taint engine state */
-    *api.getTaintEngine() = *this->snapshotTaintEngine;
+    /* 3 - Restore current symbolic engine state */
+    *api.getSymbolicEngine() = *node.triton_state.symEngine;
+    //The path constraints are the ones of the snapshot, whatever their number
+    branch_index.invalidate();
 
-    /* 4 - Restore current AST context */
-    *api.getAstContext() = *this->astCtx;
+    /* 4 - Restore current taint engine state */
+    *api.getTaintEngine() = *node.triton_state.taintEngine;
 
-    /* 5 - Restore the Triton CPU state */
+    /* 5 - Restore current AST context */
+    *api.getAstContext() = *node.triton_state.astCtx;
+
+    /* 6 - Restore the Triton CPU state */
     switch (api.getArchitecture()) {
     case triton::arch::ARCH_X86_64:
-        *reinterpret_cast<triton::arch::x86::x8664Cpu*>(api.getCpuInstance()) = *this->cpu_x8664;
+        *reinterpret_cast<triton::arch::x86::x8664Cpu*>(api.getCpuInstance()) = *node.triton_state.cpu_x8664;
         break;
     case triton::arch::ARCH_X86:
-        *reinterpret_cast<triton::arch::x86::x86Cpu*>(api.getCpuInstance()) = *this->cpu_x86;
+        *reinterpret_cast<triton::arch::x86::x86Cpu*>(api.getCpuInstance()) = *node.triton_state.cpu_x86;
         break;
     case triton::arch::ARCH_AARCH64:
-        *reinterpret_cast<triton::arch::arm::aarch64::AArch64Cpu*>(api.getCpuInstance()) = *this->cpu_AArch64;
+        *reinterpret_cast<triton::arch::arm::aarch64::AArch64Cpu*>(api.getCpuInstance()) = *node.triton_state.cpu_AArch64;
         break;
     case triton::arch::ARCH_ARM32:
-        *reinterpret_cast<triton::arch::arm::arm32::Arm32Cpu*>(api.getCpuInstance()) = *this->cpu_Arm32;
+        *reinterpret_cast<triton::arch::arm::arm32::Arm32Cpu*>(api.getCpuInstance()) = *node.triton_state.cpu_Arm32;
         break;
     default:
         throw triton::exceptions::Architecture("Architecture not supported.");
@@ -132,20 +248,22 @@ void Snapshot::restoreSnapshot() {
 
     this->mustBeRestore = false;
 
-    /* 6 - Restore IDA registers context
+    /* 7 - Restore IDA registers context
     Suposedly XIP should be set at the same time and execution redirected*/
-    typedef std::map<std::string, triton::uint512>::iterator it_type;
-    for (it_type iterator = this->IDAContext.begin(); iterator != this->IDAContext.end(); iterator++) {
-        if (!set_reg_val(iterator->first.c_str(), iterator->second.convert_to<uint64>()))
-            msg("[!] ERROR restoring register %s\n", iterator->first.c_str());
+    for (const auto& [name, value] : this->getRegisters(id)) {
+        if (!set_reg_val(name.c_str(), value.convert_to<uint64>()))
+            msg("[!] ERROR restoring register %s\n", name.c_str());
     }
+    invalidate_register_cache();
 
-    /* 7 - Restore the Ponce status */
-    ponce_runtime_status = this->saved_ponce_runtime_status;
+    /* 8 - Restore the Ponce status */
+    ponce_runtime_status = node.saved_ponce_runtime_status;
 
-    /* 8 - We need to set to NULL the last instruction. We are deleting the last instructions in the Tritonize callback.
-    So after restore a snapshot if last_instruction is not NULL is double freeing the same instruction */
+    /* 9 - The saved last instruction was only borrowed from the instruction pool and it may have been recycled
+    since the snapshot was taken, so there is no valid last instruction after a restore */
     ponce_runtime_status.last_triton_instruction = nullptr;
+
+    this->current = (ssize_t)id;
 }
 
 /* Disable the snapshot engine. */
@@ -157,30 +275,53 @@ void Snapshot::disableSnapshot(void) {
 /* Reset the snapshot engine.
 * Clear all backups for a new snapshot. */
 void Snapshot::resetEngine(void) {
-    if (!this->snapshotTaken)
+    if (this->snapshots.empty())
         return;
 
+    //A pending color would be written again after we delete it
+    flush_annotations();
+    //We delete the comments and colors that we created
+    for (const auto& node : this->snapshots) {
+        ponce_set_cmt(node.address, "", false);
+        del_item_color(node.address);
+    }
+    flush_annotations();
+
+    this->snapshots.clear();
     this->memory.clear();
+    this->current = -1;
+    this->locked = true;
+}
 
-    //ToDo: We should delete this when this issue is fixed: https://github.com/JonathanSalwan/Triton/issues/385
-    delete this->snapshotSymEngine;
-    this->snapshotSymEngine = nullptr;
 
-    delete this->snapshotTaintEngine;
-    this->snapshotTaintEngine = nullptr;
+/* Check if the snapshot engine is locked. */
+bool Snapshot::isLocked(void) {
+    return this->locked;
+}
 
-    this->snapshotTaken = false;
 
-    //We delete the comment and color that we created
-    ponce_set_cmt(this->address, "", false);
-    del_item_color(this->address);
-    this->address = 0;
+size_t Snapshot::getNumberOfSnapshots(void) const {
+    return this->snapshots.size();
 }
 
 
-/* Check if the snapshot engine is locked. */
-bool Snapshot::isLocked(void) {
-    return this->locked;
+const snapshot_node_t& Snapshot::getSnapshot(size_t id) const {
+    return this->snapshots.at(id);
+}
+
+
+ssize_t Snapshot::getCurrent(void) const {
+    return this->current;
+}
+
+
+/* The comments are deleted every time Ponce cleans its comments, we put them back */
+void Snapshot::addComments(void) {
+    for (const auto& node : this->snapshots) {
+        std::string comment = "Snapshot " + node.name + " taken here";
+        ponce_set_cmt(node.address, comment.c_str(), false, true);
+    }
+    flush_annotations();
 }
 
 
@@ -11,7 +11,10 @@
 #include <pro.h>
 
 #include <map>
+#include <memory>
 #include <set>
+#include <string>
+#include <vector>
 
 /* libTriton */
 #include <triton/api.hpp>
@@ -26,59 +29,78 @@
 // Ponce
 #include "runtime_status.hpp"
 
-//! \class Snapshot
-//! \brief the snapshot class.
-class Snapshot {
+//! Memory content as non adjacent runs of bytes indexed by their start address.
+typedef std::map<ea_t, std::vector<uint8>> memory_runs_t;
+
+//! Copy of the Triton engines. The copies share the AST nodes with the engines they were copied from.
+struct triton_state_t {
+    std::shared_ptr<triton::engines::symbolic::SymbolicEngine> symEngine;
+    std::shared_ptr<triton::engines::taint::TaintEngine> taintEngine;
+    std::shared_ptr<triton::ast::AstContext> astCtx;
+    std::shared_ptr<triton::arch::x86::x8664Cpu> cpu_x8664;
+    std::shared_ptr<triton::arch::x86::x86Cpu> cpu_x86;
+    std::shared_ptr<triton::arch::arm::aarch64::AArch64Cpu> cpu_AArch64;
+    std::shared_ptr<triton::arch::arm::arm32::Arm32Cpu> cpu_Arm32;
+};
 
-private:
-    //! I/O memory monitoring for snapshot.
-    std::map<ea_t, char> memory;
+//! A node of the snapshot tree. The debugger state is stored as a delta from the parent snapshot.
+struct snapshot_node_t {
+    //! Name given by the user.
+    std::string name;
 
-    //! Status of the snapshot engine.
-    bool locked;
+    //! Address where the snapshot was taken.
+    ea_t address = BADADDR;
 
-    //! Status of the snapshot engine.
-    bool snapshotTaken;
+    //! Index of the parent snapshot, -1 for the first one.
+    ssize_t parent = -1;
 
-    //! Flag which defines if we must restore the snapshot.
-    bool mustBeRestore;
+    //! Distance to the first snapshot.
+    size_t depth = 0;
+
+    //! Content of the memory written since the parent was taken, as it was in the parent.
+    memory_runs_t old_memory;
+
+    //! Content of the same runs when this snapshot was taken.
+    memory_runs_t new_memory;
+
+    //! Registers that changed since the parent (all of them for the first snapshot).
+    std::map<std::string, triton::uint512> registers;
 
-    //! AST node state.
-    std::set<triton::ast::AbstractNode*> nodesList;
+    //! Triton engines.
+    triton_state_t triton_state;
 
-    //! Variables node state.
-    std::map<std::string, triton::ast::AbstractNode*> variablesMap;
+    //! Number of path constraints when the snapshot was taken.
+    size_t path_constraints = 0;
+
+    //! Snapshot of the ponce plugin status
+    struct runtime_status_t saved_ponce_runtime_status;
+};
 
-    //! Snapshot of the symbolic engine.
-    triton::engines::symbolic::SymbolicEngine* snapshotSymEngine;
+//! \class Snapshot
+//! \brief the snapshot class. It keeps a tree of snapshots, the current one is the last taken or restored.
+class Snapshot {
 
-    //! Snapshot of the taint engine.
-    triton::engines::taint::TaintEngine* snapshotTaintEngine;
+private:
+    //! Every snapshot taken, indexed by its id.
+    std::vector<snapshot_node_t> snapshots;
 
-    //! AST Context
-    triton::ast::AstContext* astCtx;
+    //! The snapshot the process state derives from, -1 if there is none.
+    ssize_t current;
 
-    //! Snapshot of triton CPU.
-    triton::arch::x86::x8664Cpu* cpu_x8664;
-    triton::arch::x86::x86Cpu* cpu_x86;
-    triton::arch::arm::aarch64::AArch64Cpu * cpu_AArch64;
-    triton::arch::arm::arm32::Arm32Cpu* cpu_Arm32;
+    //! I/O memory monitoring since the current snapshot was taken or restored. Content before the writes.
+    memory_runs_t memory;
 
-#if defined(__x86_64__) || defined(_M_X64)
-    
-#endif
-#if defined(__i386) || defined(_M_IX86)
-    triton::arch::x86::x86Cpu* cpu;
-#endif
+    //! Status of the snapshot engine.
+    bool locked;
 
-    //! Snapshot of Pin context.
-    std::map<std::string, triton::uint512> IDAContext;
+    //! Flag which defines if we must restore the snapshot.
+    bool mustBeRestore;
 
-    //! Snapshot of the ponce plugin status
-    struct runtime_status_t saved_ponce_runtime_status;
+    //! Returns the value of every register in the snapshot.
+    std::map<std::string, triton::uint512> getRegisters(ssize_t id) const;
 
-    //! address where the snapshot was taken
-    ea_t address;
+    //! Writes memory runs to the debugged process.
+    void writeMemory(const memory_runs_t& runs) const;
 
 public:
     //! Constructor.
@@ -93,28 +115,39 @@ public:
     //! Returns true if we must restore the context.
     bool mustBeRestored(void);
 
-    //! Adds a memory modifiction.
-    void addModification(ea_t address, char byte);
+    //! Adds a memory modifiction. bytes is the content before the write.
+    void addModification(ea_t address, const uint8* bytes, size_t size);
 
     //! Disables the snapshot engine.
     void disableSnapshot(void);
 
-    //! Resets the snapshot engine.
+    //! Resets the snapshot engine. Deletes every snapshot.
     void resetEngine(void);
 
-    //! Restores a snapshot.
+    //! Restores the current snapshot.
     void restoreSnapshot();
 
+    //! Restores any snapshot of the tree.
+    void restoreSnapshot(size_t id);
+
     //! Sets the restore flag.
     void setRestore(bool flag);
 
-    //! Takes a snapshot.
-    void takeSnapshot();
+    //! Takes a snapshot, child of the current one. Returns its id.
+    size_t takeSnapshot(const std::string& name, ea_t address);
 
     //! Tells if a snapshot has been taken
     bool exists(void);
 
-    //! Setter for the address where the snaphsot was taken
-    void setAddress(ea_t address);
-};
+    //! Returns the number of snapshots.
+    size_t getNumberOfSnapshots(void) const;
 
+    //! Returns a snapshot by id.
+    const snapshot_node_t& getSnapshot(size_t id) const;
+
+    //! Returns the id of the current snapshot, -1 if there is none.
+    ssize_t getCurrent(void) const;
+
+    //! Adds the comment and color of every snapshot in the disassembly.
+    void addComments(void);
+};
@@ -1,9 +1,144 @@
 
 #include "solver.hpp"
 #include "globals.hpp"
+#include "instruction_cache.hpp"
+#include "memory_cache.hpp"
+#include "context.hpp"
+#include "formula.hpp"
+#include "incremental_solver.hpp"
+#include "batch_solver.hpp"
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <thread>
 
 #include <dbg.hpp>
+#include <diskio.hpp>
+#include <nalt.hpp>
+
+
+/* The solver files are in the IDA user directory, named after the hash of the analyzed binary.
+Returns an empty string if the input file hash is not available */
+static std::string get_solver_path(const char* extension)
+{
+    uchar hash[32];
+    if (!retrieve_input_file_sha256(hash))
+        return "";
+
+    qstring path;
+    path.sprnt("%s%cponce", get_user_idadir(), DIRCHAR);
+    qmkdir(path.c_str(), 0755);
+    path.append(DIRCHAR);
+    for (size_t i = 0; i < sizeof(hash); i++)
+        path.cat_sprnt("%02x", hash[i]);
+    path.append(extension);
+    return path.c_str();
+}
 
+/* Starts or stops writing the queries to the corpus directory of the binary, as the configuration says */
+static void open_query_corpus()
+{
+    if (!cmdOptions.exportSolverQueries) {
+        incremental_solver.setCorpus(nullptr);
+        return;
+    }
+    std::string path = get_solver_path(".queries");
+    if (!path.empty() && query_corpus.open(path))
+        incremental_solver.setCorpus(&query_corpus);
+    else
+        msg("[!] Error creating the query corpus directory %s\n", path.c_str());
+}
+
+static std::mutex query_cache_file_mutex;
+static std::string query_cache_loaded_path;
+
+/* Loads the solver results saved on disk the first time the binary is solved */
+static void load_query_cache()
+{
+    if (!cmdOptions.cacheSolverResultsOnDisk)
+        return;
+
+    std::lock_guard<std::mutex> lock(query_cache_file_mutex);
+    std::string path = get_solver_path(".qcache");
+    if (path.empty() || path == query_cache_loaded_path)
+        return;
+    query_cache_loaded_path = path;
+    if (query_cache.load(path) && cmdOptions.showDebugInfo)
+        msg("[+] Solver results loaded from %s\n", path.c_str());
+}
+
+static void save_query_cache()
+{
+    if (!cmdOptions.cacheSolverResultsOnDisk)
+        return;
+
+    std::lock_guard<std::mutex> lock(query_cache_file_mutex);
+    std::string path = get_solver_path(".qcache");
+    if (!path.empty() && !query_cache.save(path))
+        msg("[!] Error saving the solver results to %s\n", path.c_str());
+}
+
+/* Builds the Input of a model and shows its values */
+static Input model_to_input(size_t path_constraint_index, triton::uint64 srcAddr, triton::uint64 dstAddr, const std::unordered_map<triton::usize, triton::engines::solver::SolverModel>& model)
+{
+    Input newinput;
+    //Clone object 
+    newinput.path_constraint_index = path_constraint_index;
+    newinput.dstAddr = dstAddr;
+    newinput.srcAddr = srcAddr;
+
+    msg("[+] Solution found to reach " MEM_FORMAT "! Values:\n", (ea_t)dstAddr);
+    for (const auto& [symId, model] : model) {
+        triton::engines::symbolic::SharedSymbolicVariable  symbVar = api.getSymbolicVariable(symId);
+        std::string  symbVarComment = symbVar->getComment();
+        triton::uint512 model_value = model.getValue();
+        if (symbVar->getType() == triton::engines::symbolic::variable_e::MEMORY_VARIABLE) {
+            auto mem = triton::arch::MemoryAccess(symbVar->getOrigin(), symbVar->getSize() / 8);
+            newinput.memOperand.push_back(mem);
+            newinput.memValue.push_back(model_value);
+        }
+        else if (symbVar->getType() == triton::engines::symbolic::variable_e::REGISTER_VARIABLE) {
+            auto reg = triton::arch::Register(*api.getCpuInstance(), (triton::arch::register_e)symbVar->getOrigin());
+            newinput.regOperand.push_back(reg);
+            newinput.regValue.push_back(model_value);
+        }
+        switch (symbVar->getSize())
+        {
+        case 8:
+            msg(" - %s%s: %#02x %s\n", 
+                model.getVariable()->getName().c_str(), 
+                !symbVarComment.empty()? (" ("+symbVarComment+")").c_str():"",
+                model_value.convert_to<uchar>(), 
+                isprint(model_value.convert_to<uchar>()) ? ("(" + std::string(1, model_value.convert_to<uchar>()) + ")").c_str()  : "");
+            break;
+        case 16:
+            msg(" - %s%s: %#04x (%c%c)\n", 
+                !symbVarComment.empty() ? (" (" + symbVarComment + ")").c_str() : "",
+                symbVarComment.c_str(), 
+                model_value.convert_to<ushort>(), 
+                model_value.convert_to<uchar>() == 0 ? ' ' : model_value.convert_to<uchar>(), 
+                (unsigned char)(model_value.convert_to<ushort>() >> 8) == 0 ? ' ' : (unsigned char)(model_value.convert_to<ushort>() >> 8));
+            break;
+        case 32:
+            msg(" - %s%s: %#08x\n", 
+                !symbVarComment.empty() ? (" (" + symbVarComment + ")").c_str() : "",
+                symbVarComment.c_str(), 
+                model_value.convert_to<uint32>());
+            break;
+        case 64:
+            msg(" - %s%s: %#16llx\n", 
+                model.getVariable()->getName().c_str(), 
+                !symbVarComment.empty() ? (" (" + symbVarComment + ")").c_str() : "",
+                model_value.convert_to<uint64>());
+            break;
+        default:
+            msg("[!] Unsupported size for the symbolic variable: %s (%s)\n", model.getVariable()->getName().c_str(), symbVarComment.c_str()); // what about 128 - 512 registers? 
+        }
+    }
+    return newinput;
+}
 
 /* This function return a vector of Inputs. A vector is necesary since switch conditions may have multiple branch constraints*/
 std::vector<Input> solve_formula(ea_t pc, size_t path_constraint_index)
@@ -19,115 +154,72 @@ std::vector<Input> solve_formula(ea_t pc, size_t path_constraint_index)
     // Double check that the condition at the path constraint index is at the address the user selected
     assert(std::get<1>(pathConstrains[path_constraint_index].getBranchConstraints()[0]) == pc);
 
-    auto ast = api.getAstContext();
-    // We are going to store here the constraints for the previous conditions
-    // We can not initializate this to null, so we do it to a true condition (based on code_coverage_crackme_xor.py from the triton project)
-    auto previousConstraints = ast->equal(ast->bvtrue(), ast->bvtrue());
+    auto userConstraints = get_solver_job_user_constraints();
+    load_query_cache();
+    open_query_corpus();
 
-    // Add user define constraints (borrar en reejecuccion, poner mensaje if not sat, 
-    if (ponce_table_chooser){
-        for (const auto& [id, constrain] : ponce_table_chooser->constrains) {
-            for (const auto& [abstract_node_constrain, str_constrain] : constrain) {
-                previousConstraints = ast->land(previousConstraints, abstract_node_constrain);
-            }
+    if (cmdOptions.showExtraDebugInfo) {
+        for (auto const& [srcAddr, dstAddr, final_expr] : build_branch_formulas(api, path_constraint_index, userConstraints)) {
+            std::stringstream ss;
+            ss << "(set-logic QF_AUFBV)" << std::endl;
+            api.printSlicedExpressions(ss, api.newSymbolicExpression(final_expr), true);      
+            msg("[+] Formula:\n%s\n\n", ss.str().c_str());
         }
-    }  
-
-    // First we iterate through the previous path constrains to add the predicates of the taken path
-    unsigned int j;
-    for (j = 0; j < path_constraint_index; j++)
-    {
-        if (cmdOptions.showExtraDebugInfo)
-            msg("[+] Keeping condition %d\n", j);
-
-        // We add to the previous constraints the predicate for the taken branch 
-        auto predicate = pathConstrains[j].getTakenPredicate();
-        previousConstraints = ast->land(previousConstraints, predicate);
     }
 
-    // Then we use the predicate for the non taken path so we "solve" that condition.
     // We try to solve every non taken branch (more than one is possible under certain situations
-    for (auto const& [taken, srcAddr, dstAddr, constraint] : pathConstrains[path_constraint_index].getBranchConstraints()) {
-        if (!taken) {
-            // We concatenate the previous constraints for the taken path plus the non taken constrain of the user selected condition
-            triton::ast::SharedAbstractNode final_expr = ast->land(previousConstraints, constraint);
-            if (cmdOptions.showExtraDebugInfo) {  
-                std::stringstream ss;
-                ss << "(set-logic QF_AUFBV)" << std::endl;
-                api.printSlicedExpressions(ss, api.newSymbolicExpression(final_expr), true);      
-                msg("[+] Formula:\n%s\n\n", ss.str().c_str());
-            }
-
-            //Time to solve
-            auto model = api.getModel(final_expr);
-
-            if (model.size() > 0) {
-                Input newinput;
-                //Clone object 
-                newinput.path_constraint_index = path_constraint_index;
-                newinput.dstAddr = dstAddr;
-                newinput.srcAddr = srcAddr;
-
-                msg("[+] Solution found! Values:\n");
-                for (const auto& [symId, model] : model) {
-                    triton::engines::symbolic::SharedSymbolicVariable  symbVar = api.getSymbolicVariable(symId);
-                    std::string  symbVarComment = symbVar->getComment();
-                    triton::uint512 model_value = model.getValue();
-                    if (symbVar->getType() == triton::engines::symbolic::variable_e::MEMORY_VARIABLE) {
-                        auto mem = triton::arch::MemoryAccess(symbVar->getOrigin(), symbVar->getSize() / 8);
-                        newinput.memOperand.push_back(mem);
-                        api.setConcreteMemoryValue(mem, model_value);
-                    }
-                    else if (symbVar->getType() == triton::engines::symbolic::variable_e::REGISTER_VARIABLE) {
-                        auto reg = triton::arch::Register(*api.getCpuInstance(), (triton::arch::register_e)symbVar->getOrigin());
-                        newinput.regOperand.push_back(reg);
-                        api.setConcreteRegisterValue(reg, model_value);
-                    }
-                    switch (symbVar->getSize())
-                    {
-                    case 8:
-                        msg(" - %s%s: %#02x %s\n", 
-                            model.getVariable()->getName().c_str(), 
-                            !symbVarComment.empty()? (" ("+symbVarComment+")").c_str():"",
-                            model_value.convert_to<uchar>(), 
-                            isprint(model_value.convert_to<uchar>()) ? ("(" + std::string(1, model_value.convert_to<uchar>()) + ")").c_str()  : "");
-                        break;
-                    case 16:
-                        msg(" - %s%s: %#04x (%c%c)\n", 
-                            !symbVarComment.empty() ? (" (" + symbVarComment + ")").c_str() : "",
-                            symbVarComment.c_str(), 
-                            model_value.convert_to<ushort>(), 
-                            model_value.convert_to<uchar>() == 0 ? ' ' : model_value.convert_to<uchar>(), 
-                            (unsigned char)(model_value.convert_to<ushort>() >> 8) == 0 ? ' ' : (unsigned char)(model_value.convert_to<ushort>() >> 8));
-                        break;
-                    case 32:
-                        msg(" - %s%s: %#08x\n", 
-                            !symbVarComment.empty() ? (" (" + symbVarComment + ")").c_str() : "",
-                            symbVarComment.c_str(), 
-                            model_value.convert_to<uint32>());
-                        break;
-                    case 64:
-                        msg(" - %s%s: %#16llx\n", 
-                            model.getVariable()->getName().c_str(), 
-                            !symbVarComment.empty() ? (" (" + symbVarComment + ")").c_str() : "",
-                            model_value.convert_to<uint64>());
-                        break;
-                    default:
-                        msg("[!] Unsupported size for the symbolic variable: %s (%s)\n", model.getVariable()->getName().c_str(), symbVarComment.c_str()); // what about 128 - 512 registers? 
-                    }
-                }
-                solutions.push_back(newinput);
-            }
-            else {
-                msg("[!] No solution found :(\n");
-            }
+    // The solver already has the predicates of the previous conditions, it only receives the new ones
+    for (auto const& [srcAddr, dstAddr, model] : incremental_solver.solve(api, path_constraint_index, userConstraints)) {
+        if (model.size() > 0) {
+            solutions.push_back(model_to_input(path_constraint_index, srcAddr, dstAddr, model));
+        }
+        else {
+            msg("[!] No solution found :(\n");
         }
     }
+    save_query_cache();
+    if (cmdOptions.showDebugInfo) {
+        auto [hits, misses] = query_cache.getStats();
+        msg("[+] Solver cache: %u hits, %u misses\n", (unsigned int)hits, (unsigned int)misses);
+    }
     return solutions;
 }
 
 
 
+/* Solves the negation of every symbolic branch of the current path at once and shows the new inputs ranked,
+the ones reaching new code first */
+void solve_all_branches_and_report()
+{
+    unsigned int threads = std::max(1u, std::thread::hardware_concurrency());
+    msg("[+] Solving every symbolic branch of %u path constraints with %u threads...\n", (unsigned int)api.getPathConstraints().size(), threads);
+
+    load_query_cache();
+    auto inputs = solve_all_branches(api, threads, get_solver_job_user_constraints(), &query_cache, get_solver_limits(), get_solver_job_solvers());
+    save_query_cache();
+
+    msg("[+] %u new inputs found\n", (unsigned int)inputs.size());
+    unsigned int rank = 1;
+    for (const auto& input : inputs) {
+        msg("[+] #%u: " MEM_FORMAT " -> " MEM_FORMAT "%s (path constraint %u)\n",
+            rank++,
+            (ea_t)input.srcAddr,
+            (ea_t)input.dstAddr,
+            input.new_target ? " reaches new code" : "",
+            (unsigned int)input.path_constraint_index);
+        for (const auto& [symId, model] : input.model) {
+            std::string symbVarComment = model.getVariable()->getComment();
+            std::stringstream stream;
+            stream << std::hex << model.getValue();
+            msg(" - %s%s: 0x%s\n",
+                model.getVariable()->getName().c_str(),
+                !symbVarComment.empty() ? (" (" + symbVarComment + ")").c_str() : "",
+                stream.str().c_str());
+        }
+    }
+}
+
+
 /*This function identify the type of condition jmp and negate the flags to negate the jmp.
 Probably it is possible to do this with the solver, adding more variable to the formula to
 identify the flag of the conditions and get the values. But for now we are doing it in this way.*/
@@ -336,15 +428,23 @@ void negate_flag_condition(triton::arch::Instruction* triton_instruction)
     default:
         msg("[!] We cannot negate %s instruction\n", triton_instruction->getDisassembly().c_str());
     }
+    invalidate_register_cache();
 }
 
 
 /*We set the memory to the results we got and do the analysis from there*/
 void set_SMT_solution(const Input& solution) {
+    //Injecting a solution is followed by a path the index has not seen
+    branch_index.invalidate();
+    trace_recorder.recordEngineEdit(TRACE_EDIT_SOLUTION);
     /*To set the memory types*/
-    for (const auto& mem : solution.memOperand){
+    for (size_t i = 0; i < solution.memOperand.size(); i++) {
+        const auto& mem = solution.memOperand[i];
+        api.setConcreteMemoryValue(mem, solution.memValue[i]);
         auto concreteValue = api.getConcreteMemoryValue(mem, false);
         put_bytes((ea_t)mem.getAddress(), &concreteValue, mem.getSize());
+        invalidate_instruction_cache((ea_t)mem.getAddress(), mem.getSize());
+        invalidate_memory_cache();
         api.setConcreteMemoryValue(mem, concreteValue);
 
         if (cmdOptions.showExtraDebugInfo){
@@ -361,9 +461,12 @@ void set_SMT_solution(const Input& solution) {
     }
 
     /*To set the register types*/
-    for (const auto& reg : solution.regOperand) {
+    for (size_t i = 0; i < solution.regOperand.size(); i++) {
+        const auto& reg = solution.regOperand[i];
+        api.setConcreteRegisterValue(reg, solution.regValue[i]);
         auto concreteRegValue = api.getConcreteRegisterValue(reg, false);
         set_reg_val(reg.getName().c_str(), concreteRegValue.convert_to<uint64>());
+        invalidate_register_cache();
         api.setConcreteRegisterValue(reg, concreteRegValue);
 
         if (cmdOptions.showExtraDebugInfo) {
@@ -385,43 +488,154 @@ void set_SMT_solution(const Input& solution) {
 }
 
 
-void negate_inject_maybe_restore_solver(ea_t pc, int path_constraint_index, bool restore) {
+/* Lists inputs so the user picks one. Returns its index or -1 */
+struct input_chooser_t : public chooser_t
+{
+protected:
+    static const int widths_[];
+    static const char* const header_[];
+    const std::vector<Input>& inputs;
+
+public:
+    input_chooser_t(const char* title, const std::vector<Input>& inputs) : chooser_t(CH_MODAL | CH_KEEP, qnumber(widths_), widths_, header_, title), inputs(inputs) {}
+
+    virtual size_t idaapi get_count() const { return this->inputs.size(); }
+
+    virtual void idaapi get_row(qstrvec_t* cols, int* icon_, chooser_item_attrs_t* attrs, size_t n) const
+    {
+        const Input& input = this->inputs[n];
+        qstrvec_t& cols_ = *cols;
+        cols_[0].sprnt(MEM_FORMAT, (ea_t)input.dstAddr);
+        for (size_t i = 0; i < input.memOperand.size(); i++) {
+            std::stringstream stream;
+            stream << std::hex << input.memValue[i];
+            cols_[1].cat_sprnt("%s[" MEM_FORMAT "]=0x%s", cols_[1].empty() ? "" : " ", (ea_t)input.memOperand[i].getAddress(), stream.str().c_str());
+        }
+        for (size_t i = 0; i < input.regOperand.size(); i++) {
+            std::stringstream stream;
+            stream << std::hex << input.regValue[i];
+            cols_[1].cat_sprnt("%s%s=0x%s", cols_[1].empty() ? "" : " ", input.regOperand[i].getName().c_str(), stream.str().c_str());
+        }
+    }
+};
+
+const int input_chooser_t::widths_[] = { 16, 60 };
+const char* const input_chooser_t::header_[] = { "Target", "Values" };
+
+
+/* The models enumerated for a path constraint. They are valid while the path constraint is the same, so the user
+can pick another target without solving again. The predicate is kept so its address is not reused */
+struct enumeration_t {
+    triton::ast::SharedAbstractNode predicate;
+    size_t max_models;
+    std::vector<Input> inputs;
+};
+
+static std::mutex enumerations_mutex;
+static std::map<size_t, enumeration_t> enumerations;
+
+void clear_enumerations()
+{
+    std::lock_guard<std::mutex> lock(enumerations_mutex);
+    enumerations.clear();
+}
+
+/* Returns up to max_models inputs for the branch at path_constraint_index: different targets for a jump with a symbolic
+target, different inputs reaching the non taken branch otherwise */
+std::vector<Input> enumerate_formula(ea_t pc, size_t path_constraint_index, size_t max_models)
+{
+    const auto& pathConstraints = api.getPathConstraints();
+    if (path_constraint_index >= pathConstraints.size()) {
+        msg("Error. Requested path constraint index %u is larger than PathConstraints vector size (%lu)\n", (unsigned int)path_constraint_index, pathConstraints.size());
+        return std::vector<Input>();
+    }
+    auto predicate = pathConstraints[path_constraint_index].getTakenPredicate();
+
+    {
+        std::lock_guard<std::mutex> lock(enumerations_mutex);
+        auto it = enumerations.find(path_constraint_index);
+        if (it != enumerations.end() && it->second.predicate == predicate && it->second.max_models >= max_models) {
+            std::vector<Input> inputs(it->second.inputs.begin(), it->second.inputs.begin() + std::min(max_models, it->second.inputs.size()));
+            msg("[+] %u models of the condition at " MEM_FORMAT " were already enumerated\n", (unsigned int)inputs.size(), pc);
+            return inputs;
+        }
+    }
+
+    std::vector<Input> inputs;
+    for (auto const& [srcAddr, dstAddr, model] : incremental_solver.enumerate(api, path_constraint_index, max_models, get_solver_job_user_constraints()))
+        inputs.push_back(model_to_input(path_constraint_index, srcAddr, dstAddr, model));
+    msg("[+] %u models found for the condition at " MEM_FORMAT "\n", (unsigned int)inputs.size(), pc);
+
+    // An interrupted enumeration is not complete
+    if (!incremental_solver.isInterrupted()) {
+        std::lock_guard<std::mutex> lock(enumerations_mutex);
+        enumerations[path_constraint_index] = { predicate, max_models, inputs };
+    }
+    return inputs;
+}
+
+
+/* Lets the user pick one of the inputs and injects it, from the snapshot if there is one so the execution can reach its target */
+solver_job_result_t enumerate_and_pick(ea_t pc, size_t path_constraint_index, size_t max_models)
+{
+    auto inputs = enumerate_formula(pc, path_constraint_index, max_models);
+    if (inputs.empty())
+        return nullptr;
+
+    return [inputs]() {
+        input_chooser_t chooser("Pick the input to inject", inputs);
+        ssize_t chosen = chooser.choose();
+        if (chosen < 0)
+            return;
+        if (snapshot.exists())
+            snapshot.restoreSnapshot();
+        set_SMT_solution(inputs[chosen]);
+        msg("[+] Input reaching " MEM_FORMAT " injected\n", (ea_t)inputs[chosen].dstAddr);
+    };
+}
+
+
+/*It runs in the solver job thread. What modifies the process and the engines is returned to run in the UI thread,
+only if the path constraints are still the ones solved*/
+solver_job_result_t negate_inject_maybe_restore_solver(ea_t pc, int path_constraint_index, bool restore) {
     auto solutions = solve_formula(pc, path_constraint_index);
+    if (solutions.empty())
+        return nullptr;
 
-    Input* chosen_solution = nullptr;
-    if (solutions.size() > 0) {
-        if (solutions.size() == 1) {
-            chosen_solution = &solutions[0];
-            triton::ast::SharedAbstractNode new_constraint;
-            for (auto& [taken, srcAddr, dstAddr, constraint] : api.getPathConstraints().back().getBranchConstraints()) {
-                // Let's look for the constraint we have force to take wich is the a priori not taken one
-                if (!taken) {
-                    new_constraint = constraint;
-                    break;
-                }
-            }
-            // Once found we first pop the last path constraint
-            api.popPathConstraint();
-            // And replace it for the found previously
-            api.pushPathConstraint(new_constraint);
+    return [solutions, restore]() {
+        // Several solutions means several non taken targets (switch tables), the user chooses
+        size_t chosen = 0;
+        if (solutions.size() > 1) {
+            input_chooser_t chooser("Pick the branch to take", solutions);
+            ssize_t choice = chooser.choose();
+            if (choice < 0)
+                return;
+            chosen = (size_t)choice;
         }
-        else {
-            // ToDo: what do we do if we are in a switch case and get several solutions? Just using the first one? Ask the user?
-            for (const auto& solution : solutions) {
-                // ask the user where he wants to go in popup or even better in the contextual menu
-                // chosen_solution = &solutions[0];
-                //We need to modify the last path constrain from api.getPathConstraints()
-                for (auto& [taken, srcAddr, dstAddr, constraint] : api.getPathConstraints().back().getBranchConstraints()) {
-                    if (!taken) {
-
-                    }
-                }
+        const Input* chosen_solution = &solutions[chosen];
+
+        triton::ast::SharedAbstractNode new_constraint;
+        for (auto& [taken, srcAddr, dstAddr, constraint] : api.getPathConstraints().back().getBranchConstraints()) {
+            // Let's look for the constraint we have force to take wich is the a priori not taken one
+            if (!taken && dstAddr == chosen_solution->dstAddr) {
+                new_constraint = constraint;
+                break;
             }
         }
+        if (!new_constraint) {
+            msg("[!] The branch to " MEM_FORMAT " is not in the last path constraint, nothing injected\n", (ea_t)chosen_solution->dstAddr);
+            return;
+        }
+        // Once found we first pop the last path constraint
+        api.popPathConstraint();
+        // And replace it for the found previously
+        api.pushPathConstraint(new_constraint);
+        branch_index.invalidate();
+
         // We negate necesary flags to go over the other branch
         negate_flag_condition(ponce_runtime_status.last_triton_instruction);
         if (restore)
             snapshot.restoreSnapshot();
         set_SMT_solution(*chosen_solution);
-    }
-}
\ No newline at end of file
+    };
+}
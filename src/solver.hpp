@@ -6,6 +6,8 @@
 
 #include <ida.hpp>
 
+#include "solver_job.hpp"
+
 class Input
 {
 public:
@@ -15,6 +17,10 @@ public:
     std::vector <triton::arch::MemoryAccess> memOperand;
     std::vector <triton::arch::Register> regOperand;
 
+    // The values found by the solver for every operand
+    std::vector <triton::uint512> memValue;
+    std::vector <triton::uint512> regValue;
+
     triton::uint64 srcAddr, dstAddr;
 
     //! Constructor.
@@ -30,4 +36,8 @@ public:
 
 
 std::vector<Input> solve_formula(ea_t pc, size_t path_constraint_index);
-void negate_inject_maybe_restore_solver(ea_t pc, int path_constraint_index, bool restore);
+solver_job_result_t negate_inject_maybe_restore_solver(ea_t pc, int path_constraint_index, bool restore);
+std::vector<Input> enumerate_formula(ea_t pc, size_t path_constraint_index, size_t max_models);
+solver_job_result_t enumerate_and_pick(ea_t pc, size_t path_constraint_index, size_t max_models);
+void clear_enumerations();
+void solve_all_branches_and_report();
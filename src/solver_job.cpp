@@ -0,0 +1,209 @@
+//! \file
+/*
+**  Copyright (c) 2020 - Ponce
+**  Authors:
+**         Alberto Garcia Illera        agarciaillera@gmail.com
+**         Francisco Oca                francisco.oca.gonzalez@gmail.com
+**
+**  This program is under the terms of the BSD License.
+*/
+
+#include <exception>
+#include <string>
+#include <thread>
+
+//IDA
+#include <ida.hpp>
+#include <kernwin.hpp>
+
+//Ponce
+#include "solver_job.hpp"
+#include "globals.hpp"
+#include "utils.hpp"
+
+static std::atomic<bool> job_running(false);
+static std::atomic<bool> job_cancelled(false);
+//The solvers of the job other than the incremental_solver (the workers of solve all branches)
+static SolverGroup job_solvers;
+//Set by the job thread when it finished, the UI thread joins it and applies the result
+static std::atomic<bool> job_finished(false);
+//Only used by the UI thread
+static std::thread job_thread;
+static qtimer_t job_timer = nullptr;
+static std::string job_description;
+static std::uint64_t job_start_time;
+static std::uint64_t job_last_report;
+//Written by the job thread before job_finished is set
+static solver_job_result_t job_result;
+
+//The path the job solves, taken in the UI thread when it starts. The result is dropped if it changed
+static size_t job_path_constraints;
+static triton::ast::SharedAbstractNode job_last_predicate;
+static triton::ast::SharedAbstractNode job_user_constraints;
+
+/* Returns the conjunction of the constraints the user added in the symbolic variables window, or nullptr if there are none */
+static triton::ast::SharedAbstractNode get_user_constraints()
+{
+    auto ast = api.getAstContext();
+    triton::ast::SharedAbstractNode userConstraints = nullptr;
+
+    // Add user define constraints (borrar en reejecuccion, poner mensaje if not sat, 
+    if (ponce_table_chooser){
+        for (const auto& [id, constrain] : ponce_table_chooser->constrains) {
+            for (const auto& [abstract_node_constrain, str_constrain] : constrain) {
+                userConstraints = userConstraints ? ast->land(userConstraints, abstract_node_constrain) : abstract_node_constrain;
+            }
+        }
+    }
+    return userConstraints;
+}
+
+static triton::ast::SharedAbstractNode get_last_predicate()
+{
+    const auto& pathConstraints = api.getPathConstraints();
+    return pathConstraints.empty() ? nullptr : pathConstraints.back().getTakenPredicate();
+}
+
+/*Joins the finished or cancelled job thread and forgets the job. UI thread only*/
+static solver_job_result_t join_solver_job()
+{
+    if (job_thread.joinable())
+        job_thread.join();
+    solver_job_result_t result = std::move(job_result);
+    job_result = nullptr;
+    job_last_predicate = nullptr;
+    job_user_constraints = nullptr;
+    job_finished = false;
+    job_running = false;
+    return result;
+}
+
+/*Timer callback, it runs in the UI thread. It applies the result of the job when it finishes and tells the user
+it is still running every SOLVER_JOB_PROGRESS_INTERVAL seconds. Returning -1 unregisters it*/
+static int idaapi poll_solver_job(void*)
+{
+    if (!job_running) {
+        job_timer = nullptr;
+        return -1;
+    }
+
+    if (!job_finished) {
+        if (GetTimeMs64() - job_last_report >= SOLVER_JOB_PROGRESS_INTERVAL * 1000) {
+            job_last_report = GetTimeMs64();
+            msg("[+] %s for %u seconds. Ponce > SMT Solver > Cancel solving stops it\n", job_description.c_str(), (unsigned int)((job_last_report - job_start_time) / 1000));
+        }
+        return SOLVER_JOB_POLL_INTERVAL;
+    }
+
+    job_timer = nullptr;
+    bool path_changed = api.getPathConstraints().size() != job_path_constraints || get_last_predicate() != job_last_predicate;
+    std::string description = job_description;
+    // The job is over before its result runs, the result can restore snapshots and change the engines
+    solver_job_result_t result = join_solver_job();
+    if (job_cancelled || !result)
+        return -1;
+    if (path_changed) {
+        msg("[!] The path changed while %s was running, its result is discarded\n", description.c_str());
+        return -1;
+    }
+    result();
+    return -1;
+}
+
+
+bool start_solver_job(const char* description, std::function<solver_job_result_t()> job)
+{
+    if (job_running) {
+        msg("[!] %s is still running, wait for it or cancel it\n", job_description.c_str());
+        return false;
+    }
+    // A job cancelled and not polled yet
+    join_solver_job();
+    job_running = true;
+    job_cancelled = false;
+    job_description = description;
+    job_start_time = job_last_report = GetTimeMs64();
+    job_path_constraints = api.getPathConstraints().size();
+    job_last_predicate = get_last_predicate();
+    job_user_constraints = get_user_constraints();
+
+    // There is no query running, this does not block
+    incremental_solver.clearInterrupt();
+    job_solvers.clearInterrupt();
+    incremental_solver.setLimits(get_solver_limits());
+    incremental_solver.setPortfolio(cmdOptions.solverPortfolio);
+
+    if (job_timer == nullptr)
+        job_timer = register_timer(SOLVER_JOB_POLL_INTERVAL, poll_solver_job, nullptr);
+
+    std::string name = description;
+    job_thread = std::thread([job, name]() {
+        solver_job_result_t result;
+        try {
+            result = job();
+        }
+        catch (const z3::exception& e) {
+            msg("[!] %s failed: %s\n", name.c_str(), e.msg());
+        }
+        catch (const std::exception& e) {
+            msg("[!] %s failed: %s\n", name.c_str(), e.what());
+        }
+
+        if (job_cancelled)
+            msg("[!] %s cancelled\n", name.c_str());
+        job_result = std::move(result);
+        job_finished = true;
+    });
+    return true;
+}
+
+
+void cancel_solver_job()
+{
+    if (!job_running)
+        return;
+    job_cancelled = true;
+    incremental_solver.interrupt();
+    job_solvers.interrupt();
+}
+
+
+void stop_solver_job()
+{
+    if (!job_running)
+        return;
+    cancel_solver_job();
+    // The job thread never waits for the UI thread so this can not deadlock
+    join_solver_job();
+    if (job_timer != nullptr) {
+        unregister_timer(job_timer);
+        job_timer = nullptr;
+    }
+}
+
+
+triton::ast::SharedAbstractNode get_solver_job_user_constraints()
+{
+    return job_user_constraints;
+}
+
+
+bool is_solver_job_running()
+{
+    return job_running;
+}
+
+
+SolverGroup* get_solver_job_solvers()
+{
+    return &job_solvers;
+}
+
+
+solver_limits_t get_solver_limits()
+{
+    solver_limits_t limits;
+    limits.timeout_ms = (unsigned int)(cmdOptions.solverTimeout * 1000);
+    limits.memory_mb = (unsigned int)cmdOptions.solverMemoryLimit;
+    return limits;
+}
@@ -0,0 +1,50 @@
+//! \file
+/*
+**  Copyright (c) 2020 - Ponce
+**  Authors:
+**         Alberto Garcia Illera        agarciaillera@gmail.com
+**         Francisco Oca                francisco.oca.gonzalez@gmail.com
+**
+**  This program is under the terms of the BSD License.
+*/
+
+/*The solving actions run in a background thread so a hard query does not freeze IDA. Only one runs at a time.
+The job reads the Triton engine, so everything changing it (tracing, restoring snapshots, restarting the engines)
+must call stop_solver_job() first. The results that modify the debugged process are applied in the UI thread by a
+timer when the job finishes, and dropped if the path constraints changed since the job started*/
+
+#pragma once
+
+#include <atomic>
+#include <functional>
+
+//Ponce
+#include "incremental_solver.hpp"
+
+//Seconds between the messages telling the user the solver is still running
+#define SOLVER_JOB_PROGRESS_INTERVAL 5
+//Milliseconds between the checks of the UI thread for the end of the job
+#define SOLVER_JOB_POLL_INTERVAL 100
+
+//What must be done with the results of a job. It runs in the UI thread, it can be empty
+typedef std::function<void()> solver_job_result_t;
+
+//Runs job in the background thread. Returns false if another job is running
+bool start_solver_job(const char* description, std::function<solver_job_result_t()> job);
+
+//Interrupts the query being solved and discards the results. Can be called from any thread
+void cancel_solver_job();
+
+//Cancels the job and waits for its thread. Called from the UI thread before changing the Triton state
+void stop_solver_job();
+
+bool is_solver_job_running();
+
+//The constraints of the symbolic variables window, built in the UI thread when the job started
+triton::ast::SharedAbstractNode get_solver_job_user_constraints();
+
+//The solvers of the current job other than the incremental_solver register here so cancelling the job interrupts them
+SolverGroup* get_solver_job_solvers();
+
+//The limits of every query set in the configuration
+solver_limits_t get_solver_limits();
@@ -0,0 +1,133 @@
+//! \file
+/*
+**  Copyright (c) 2020 - Ponce
+**  Authors:
+**         Alberto Garcia Illera        agarciaillera@gmail.com
+**         Francisco Oca                francisco.oca.gonzalez@gmail.com
+**
+**  This program is under the terms of the BSD License.
+*/
+
+#include <algorithm>
+#include <memory>
+#include <thread>
+
+#include "solver_portfolio.hpp"
+
+SolverPortfolio::SolverPortfolio() {
+    this->interrupted = false;
+}
+
+
+/*The default SMT solver, the QF_BV tactic and plain bit-blasting to SAT. Each of them is the fastest on some of
+the queries Ponce generates: the first on the ones simplified by the rewriter, the last on the big multiplications and hashes*/
+const std::vector<std::string>& SolverPortfolio::getStrategies(void) {
+    static const std::vector<std::string> strategies = { "smt", "qfbv", "bit-blast" };
+    return strategies;
+}
+
+
+z3::solver SolverPortfolio::makeSolver(z3::context& ctx, const std::string& strategy) {
+    if (strategy == "qfbv")
+        return z3::tactic(ctx, "qfbv").mk_solver();
+    if (strategy == "bit-blast")
+        return (z3::tactic(ctx, "simplify") & z3::tactic(ctx, "solve-eqs") & z3::tactic(ctx, "bit-blast") & z3::tactic(ctx, "sat")).mk_solver();
+    return z3::solver(ctx);
+}
+
+
+portfolio_result_t SolverPortfolio::solve(z3::context& ctx, const z3::expr_vector& query, unsigned int timeout_ms) {
+    portfolio_result_t result;
+    const auto& strategies = getStrategies();
+
+    // A Z3 context can only be used by a thread at a time, every strategy gets its own copy of the query.
+    // The translation reads the source context, so it is done here before any strategy starts
+    std::vector<std::unique_ptr<z3::context>> contexts;
+    std::vector<z3::expr_vector> queries;
+    for (size_t i = 0; i < strategies.size(); i++) {
+        contexts.push_back(std::make_unique<z3::context>());
+        z3::expr_vector translated(*contexts.back());
+        for (unsigned int j = 0; j < query.size(); j++)
+            translated.push_back(z3::expr(*contexts.back(), Z3_translate(ctx, query[j], *contexts.back())));
+        queries.push_back(translated);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        if (this->interrupted)
+            return result;
+        for (const auto& context : contexts)
+            this->running.push_back(context.get());
+    }
+
+    std::mutex result_mutex;
+    auto race = [&](size_t i) {
+        z3::context& strategy_ctx = *contexts[i];
+        portfolio_result_t strategy_result;
+        strategy_result.strategy = strategies[i];
+        try {
+            z3::solver solver = makeSolver(strategy_ctx, strategies[i]);
+            if (timeout_ms) {
+                z3::params params(strategy_ctx);
+                params.set("timeout", timeout_ms);
+                solver.set(params);
+            }
+            solver.add(queries[i]);
+            strategy_result.verdict = solver.check();
+            if (strategy_result.verdict == z3::sat) {
+                z3::model model = solver.get_model();
+                for (unsigned int j = 0; j < model.size(); j++) {
+                    z3::func_decl decl = model[j];
+                    if (decl.arity() != 0)
+                        continue;
+                    z3::expr value = model.get_const_interp(decl);
+                    if (value.is_numeral())
+                        strategy_result.model[decl.name().str()] = triton::uint512{ Z3_get_numeral_string(strategy_ctx, value) };
+                }
+            }
+        }
+        catch (const z3::exception&) {
+            // Interrupted or out of memory, another strategy may still answer
+            return;
+        }
+        if (strategy_result.verdict == z3::unknown)
+            return;
+
+        std::lock_guard<std::mutex> lock(result_mutex);
+        if (result.verdict != z3::unknown)
+            return;
+        result = std::move(strategy_result);
+        // We have the answer, the others can stop
+        std::lock_guard<std::mutex> running_lock(this->mutex);
+        for (size_t j = 0; j < contexts.size(); j++) {
+            if (j != i)
+                contexts[j]->interrupt();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < strategies.size(); i++)
+        threads.emplace_back(race, i);
+    race(0);
+    for (auto& thread : threads)
+        thread.join();
+
+    std::lock_guard<std::mutex> lock(this->mutex);
+    for (const auto& context : contexts)
+        this->running.erase(std::find(this->running.begin(), this->running.end(), context.get()));
+    return result;
+}
+
+
+void SolverPortfolio::interrupt(void) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->interrupted = true;
+    for (auto context : this->running)
+        context->interrupt();
+}
+
+
+void SolverPortfolio::clearInterrupt(void) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->interrupted = false;
+}
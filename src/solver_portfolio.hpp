@@ -0,0 +1,69 @@
+//! \file
+/*
+**  Copyright (c) 2020 - Ponce
+**  Authors:
+**         Alberto Garcia Illera        agarciaillera@gmail.com
+**         Francisco Oca                francisco.oca.gonzalez@gmail.com
+**
+**  This program is under the terms of the BSD License.
+*/
+
+/*Races several Z3 strategies on the same query, the first verdict wins. The solve time of bit-vector queries
+changes a lot from one strategy to another, racing them cuts the slow cases.
+It must not depend on IDA since it is shared with the offline tools*/
+
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+//Triton
+#include <triton/api.hpp>
+
+//Z3
+#include <z3++.h>
+
+//The verdict of the first strategy that found one
+struct portfolio_result_t {
+    z3::check_result verdict = z3::unknown;
+    //Name of the strategy that won
+    std::string strategy;
+    //Value of every constant of the model by name
+    std::map<std::string, triton::uint512> model;
+};
+
+//! \class SolverPortfolio
+//! \brief Solves a query with every strategy in its own thread and Z3 context.
+class SolverPortfolio {
+
+private:
+    //! Contexts of the strategies running, to interrupt them.
+    std::vector<z3::context*> running;
+
+    //! Protects running.
+    std::mutex mutex;
+
+    //! Set by interrupt(), the queries return unknown until clearInterrupt().
+    bool interrupted;
+
+public:
+    //! Constructor.
+    SolverPortfolio();
+
+    //! Names of the strategies raced.
+    static const std::vector<std::string>& getStrategies(void);
+
+    //! Returns a solver using a strategy.
+    static z3::solver makeSolver(z3::context& ctx, const std::string& strategy);
+
+    //! Solves the conjunction of the query. The expressions are translated to a context per strategy.
+    portfolio_result_t solve(z3::context& ctx, const z3::expr_vector& query, unsigned int timeout_ms);
+
+    //! Interrupts every strategy running. Can be called from any thread.
+    void interrupt(void);
+
+    //! Allows solving again after interrupt().
+    void clearInterrupt(void);
+};
@@ -0,0 +1,300 @@
+//! \file
+/*
+**  Copyright (c) 2020 - Ponce
+**  Authors:
+**         Alberto Garcia Illera        agarciaillera@gmail.com
+**         Francisco Oca                francisco.oca.gonzalez@gmail.com
+**
+**  This program is under the terms of the BSD License.
+*/
+
+#include <algorithm>
+#include <memory>
+#include <string>
+
+//Ponce
+#include "summaries.hpp"
+#include "blacklist.hpp"
+#include "context.hpp"
+#include "globals.hpp"
+#include "memory_cache.hpp"
+#include "utils.hpp"
+
+//Triton
+#include <triton/api.hpp>
+
+//The calling conventions of the summarized functions. They depend on the debugged binary, not on the IDA build
+enum summary_abi_t {
+    ABI_CDECL32,
+    ABI_MS64,
+    ABI_SYSV64,
+};
+
+static summary_abi_t get_abi()
+{
+    if (!inf_is_64bit())
+        return ABI_CDECL32;
+    return inf_get_filetype() == f_PE ? ABI_MS64 : ABI_SYSV64;
+}
+
+static const triton::arch::Register& get_return_register()
+{
+    return get_abi() == ABI_CDECL32 ? api.registers.x86_eax : api.registers.x86_rax;
+}
+
+static const function_summary_t function_summaries[] = {
+    //name              kind                buffer  source  size    string
+    { "strlen",         SUMMARY_LENGTH,     0,      -1,     -1,     true },
+    { "strnlen",        SUMMARY_LENGTH,     0,      -1,     1,      true },
+    { "lstrlenA",       SUMMARY_LENGTH,     0,      -1,     -1,     true },
+    { "strcmp",         SUMMARY_COMPARE,    0,      1,      -1,     true },
+    { "strncmp",        SUMMARY_COMPARE,    0,      1,      2,      true },
+    { "memcmp",         SUMMARY_COMPARE,    0,      1,      2,      false },
+    { "memcpy",         SUMMARY_COPY,       0,      1,      2,      false },
+    { "memmove",        SUMMARY_COPY,       0,      1,      2,      false },
+    { "RtlCopyMemory",  SUMMARY_COPY,       0,      1,      2,      false },
+    { "RtlMoveMemory",  SUMMARY_COPY,       0,      1,      2,      false },
+    { "strcpy",         SUMMARY_COPY,       0,      1,      -1,     true },
+    { "strncpy",        SUMMARY_COPY,       0,      1,      2,      true },
+    { "lstrcpyA",       SUMMARY_COPY,       0,      1,      -1,     true },
+    { "memset",         SUMMARY_FILL,       0,      1,      2,      false },
+    { "RtlFillMemory",  SUMMARY_FILL,       0,      2,      1,      false },
+    { "fread",          SUMMARY_READ,       0,      -1,     1,      false },
+    { "fgets",          SUMMARY_READ,       0,      -1,     -1,     true },
+    { "read",           SUMMARY_READ,       1,      -1,     -1,     false },
+    { "recv",           SUMMARY_READ,       1,      -1,     -1,     false },
+    { "ReadFile",       SUMMARY_READ_COUNT, 1,      -1,     3,      false },
+};
+
+//What a summary needs to know when the call returns
+struct pending_summary_t {
+    const function_summary_t* summary;
+    ea_t buffer = 0;
+    ea_t source = 0;
+    //Concrete value of the size argument, 0 if the summary has none
+    triton::uint64 size = 0;
+    //Bytes copied or filled, more than SUMMARY_MAX_BYTES if they were not followed
+    triton::uint64 count = 0;
+    //Bytes strncpy fills with zeros after the string
+    triton::uint64 padding = 0;
+    //Where the fill value of memset is: a register, or the stack slot if the register is ID_REG_INVALID
+    triton::uint32 fill_register = triton::arch::ID_REG_INVALID;
+    ea_t fill_slot = 0;
+};
+
+static uint8 read_byte(ea_t address)
+{
+    uint8 value = 0;
+    ponce_get_bytes(&value, sizeof(value), address);
+    return value;
+}
+
+//Length of the string at address, max if there is no null byte before
+static triton::uint64 concrete_strlen(ea_t address, triton::uint64 max)
+{
+    triton::uint64 length = 0;
+    while (length < max && read_byte((ea_t)(address + length)) != 0)
+        length++;
+    return length;
+}
+
+//Register of an argument, nullptr if it is passed in the stack
+static const triton::arch::Register* get_argument_register(int index)
+{
+    static const triton::arch::Register* ms64[] = { &api.registers.x86_rcx, &api.registers.x86_rdx, &api.registers.x86_r8, &api.registers.x86_r9 };
+    static const triton::arch::Register* sysv64[] = { &api.registers.x86_rdi, &api.registers.x86_rsi, &api.registers.x86_rdx, &api.registers.x86_rcx, &api.registers.x86_r8, &api.registers.x86_r9 };
+    switch (get_abi()) {
+    case ABI_MS64:
+        return index < 4 ? ms64[index] : nullptr;
+    case ABI_SYSV64:
+        return index < 6 ? sysv64[index] : nullptr;
+    default:
+        return nullptr;
+    }
+}
+
+//Stack slot of an argument passed in the stack, before the call pushes the return address
+static triton::arch::MemoryAccess get_argument_slot(int index)
+{
+    switch (get_abi()) {
+    case ABI_MS64:
+        //The caller reserves 32 bytes for the register arguments
+        return triton::arch::MemoryAccess(IDA_getCurrentRegisterValue(api.registers.x86_rsp).convert_to<triton::uint64>() + 0x20 + (index - 4) * 8, 8);
+    case ABI_SYSV64:
+        return triton::arch::MemoryAccess(IDA_getCurrentRegisterValue(api.registers.x86_rsp).convert_to<triton::uint64>() + (index - 6) * 8, 8);
+    default:
+        return triton::arch::MemoryAccess(IDA_getCurrentRegisterValue(api.registers.x86_esp).convert_to<triton::uint64>() + index * 4, 4);
+    }
+}
+
+//Concrete value of an argument before the call
+static triton::uint64 get_argument(int index)
+{
+    const triton::arch::Register* reg = get_argument_register(index);
+    if (reg)
+        return IDA_getCurrentRegisterValue(*reg).convert_to<triton::uint64>();
+    auto slot = get_argument_slot(index);
+    return IDA_getCurrentMemoryValue((ea_t)slot.getAddress(), slot.getSize()).convert_to<triton::uint64>();
+}
+
+/*The length is the index of the first null byte, we follow the string until it*/
+static void resolve_length(const pending_summary_t& pending, triton::uint64 result, summary_effect_t& effect)
+{
+    triton::uint64 bound = pending.summary->size >= 0 ? pending.size : SUMMARY_MAX_BYTES;
+    if (result > SUMMARY_MAX_BYTES)
+        return;
+    effect.kind = SUMMARY_EFFECT_LENGTH;
+    effect.bytes = std::min(result + 1, bound);
+}
+
+/*The bytes compared go until the end of the shortest string or the size. Longer comparisons are not followed*/
+static void resolve_compare(const pending_summary_t& pending, summary_effect_t& effect)
+{
+    triton::uint64 bound = pending.summary->size >= 0 ? pending.size : SUMMARY_MAX_BYTES + 1;
+    triton::uint64 limit = std::min(bound, (triton::uint64)SUMMARY_MAX_BYTES);
+    triton::uint64 bytes = limit;
+    bool terminated = false;
+    if (pending.summary->string) {
+        for (triton::uint64 i = 0; i < limit && !terminated; i++) {
+            if (read_byte((ea_t)(pending.buffer + i)) == 0 || read_byte((ea_t)(pending.source + i)) == 0) {
+                bytes = i + 1;
+                terminated = true;
+            }
+        }
+    }
+    if (!terminated && limit < bound)
+        return;
+    effect.kind = SUMMARY_EFFECT_COMPARE;
+    effect.source = pending.source;
+    effect.bytes = bytes;
+}
+
+/*The bytes read come from outside the process, what the buffer had before is lost*/
+static void resolve_read(const pending_summary_t& pending, triton::uint64 result, summary_effect_t& effect)
+{
+    triton::uint64 bytes = 0;
+    if (pending.summary->kind == SUMMARY_READ_COUNT) {
+        if (result != 0)
+            bytes = IDA_getCurrentMemoryValue((ea_t)pending.size, 4).convert_to<triton::uint64>();
+    }
+    else if (pending.summary->string) {
+        if (result != 0)
+            bytes = concrete_strlen(pending.buffer, SUMMARY_MAX_BYTES) + 1;
+    }
+    else if (pending.summary->size >= 0) {
+        bytes = result * pending.size;
+    }
+    //A negative result is an error
+    else if (result < ((triton::uint64)1 << (get_return_register().getBitSize() - 1))) {
+        bytes = result;
+    }
+    if (bytes == 0)
+        return;
+    effect.kind = SUMMARY_EFFECT_CONCRETIZE;
+    effect.bytes = bytes;
+}
+
+/*Turns what the call did into a summary_effect_t using the concrete arguments and result. The kind is 0 if there is nothing to do*/
+static summary_effect_t resolve_summary(const pending_summary_t& pending)
+{
+    summary_effect_t effect;
+    effect.name = pending.summary->name;
+    effect.buffer = pending.buffer;
+    effect.string = pending.summary->string;
+    effect.register_id = get_return_register().getId();
+    effect.result = IDA_getCurrentRegisterValue(get_return_register()).convert_to<triton::uint64>();
+
+    switch (pending.summary->kind) {
+    case SUMMARY_LENGTH:
+        resolve_length(pending, effect.result, effect);
+        break;
+    case SUMMARY_COMPARE:
+        resolve_compare(pending, effect);
+        break;
+    case SUMMARY_COPY:
+        effect.kind = pending.count > SUMMARY_MAX_BYTES ? SUMMARY_EFFECT_CONCRETIZE : SUMMARY_EFFECT_COPY;
+        effect.source = pending.source;
+        effect.bytes = pending.count;
+        effect.padding = pending.count > SUMMARY_MAX_BYTES ? 0 : pending.padding;
+        break;
+    case SUMMARY_FILL:
+        effect.kind = pending.count > SUMMARY_MAX_BYTES ? SUMMARY_EFFECT_CONCRETIZE : SUMMARY_EFFECT_FILL;
+        effect.bytes = pending.count;
+        effect.register_id = pending.fill_register;
+        effect.source = pending.fill_slot;
+        break;
+    case SUMMARY_READ:
+    case SUMMARY_READ_COUNT:
+        resolve_read(pending, effect.result, effect);
+        break;
+    }
+    return effect;
+}
+
+static void apply_summary(const summary_effect_t& effect)
+{
+    if (!effect.kind)
+        return;
+    trace_recorder.recordSummary(effect);
+    apply_summary_effect(api, effect);
+}
+
+const function_summary_t* find_summary(const char* callee)
+{
+    //The summaries follow the x86 calling conventions
+    if (api.getArchitecture() != triton::arch::ARCH_X86 && api.getArchitecture() != triton::arch::ARCH_X86_64)
+        return nullptr;
+
+    for (const auto& function_summary : function_summaries) {
+        if (strcmp(callee, function_summary.name) == 0)
+            return &function_summary;
+    }
+    return nullptr;
+}
+
+void summarize_call(const function_summary_t* summary, ea_t pc, thid_t tid)
+{
+    //The arguments are read before the call, the return address is not pushed yet
+    auto pending = std::make_shared<pending_summary_t>();
+    pending->summary = summary;
+    pending->buffer = (ea_t)get_argument(summary->buffer);
+    if (summary->source >= 0)
+        pending->source = (ea_t)get_argument(summary->source);
+    if (summary->size >= 0)
+        pending->size = get_argument(summary->size);
+
+    if (summary->kind == SUMMARY_COPY) {
+        //The bytes copied are counted before the call, the source could be overwritten by the copy
+        pending->count = pending->size;
+        if (summary->string) {
+            triton::uint64 bound = summary->size >= 0 ? pending->size : SUMMARY_MAX_BYTES + 1;
+            pending->count = std::min(concrete_strlen(pending->source, SUMMARY_MAX_BYTES + 1) + 1, bound);
+            if (summary->size >= 0)
+                pending->padding = pending->size - pending->count;
+        }
+    }
+    else if (summary->kind == SUMMARY_FILL) {
+        pending->count = pending->size;
+        const triton::arch::Register* reg = get_argument_register(summary->source);
+        if (reg)
+            pending->fill_register = reg->getId();
+        else
+            pending->fill_slot = (ea_t)get_argument_slot(summary->source).getAddress();
+    }
+
+    if (cmdOptions.showDebugInfo)
+        msg("[+] Call to %s at " MEM_FORMAT " summarized\n", summary->name, pc);
+
+    /*Nothing is processed until the call returns, so the symbolic state of the arguments is still the one they had before it.
+    The memory is written before the volatile registers are concretized since the fill value can be in one of them,
+    the result after them since it goes to one of them*/
+    skip_call(pc, tid, [pending](ea_t return_address) {
+        summary_effect_t effect = resolve_summary(*pending);
+        bool sets_result = effect.kind == SUMMARY_EFFECT_LENGTH || effect.kind == SUMMARY_EFFECT_COMPARE;
+        if (!sets_result)
+            apply_summary(effect);
+        enableTrigger_and_concretize_registers(return_address);
+        if (sets_result)
+            apply_summary(effect);
+    });
+}
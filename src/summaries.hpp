@@ -0,0 +1,53 @@
+//! \file
+/*
+**  Copyright (c) 2020 - Ponce
+**  Authors:
+**         Alberto Garcia Illera        agarciaillera@gmail.com
+**         Francisco Oca                francisco.oca.gonzalez@gmail.com
+**
+**  This program is under the terms of the BSD License.
+*/
+
+/*Symbolic summaries of common libc and Win32 routines. The call runs natively like a blacklisted one but, instead of
+concretizing, its effect is applied to the symbolic and taint state when it returns:
+- length (strlen): the result is a chain of comparisons of the string bytes with 0
+- compare (strcmp, memcmp): the result is a chain of comparisons of the bytes of both buffers
+- copy and fill (memcpy, strcpy, memset): the destination gets the expressions and the taint of the source
+- read into buffer (fread, recv, ReadFile): the bytes written come from outside, they are concretized and untainted*/
+
+#pragma once
+
+//IDA
+#include <ida.hpp>
+#include <idd.hpp>
+
+//Ponce
+#include "engine_edits.hpp"
+
+
+enum summary_kind_t {
+    SUMMARY_LENGTH,
+    SUMMARY_COMPARE,
+    SUMMARY_COPY,
+    SUMMARY_FILL,
+    SUMMARY_READ,
+    //Like SUMMARY_READ but the number of bytes read is written to the pointer of the size argument
+    SUMMARY_READ_COUNT,
+};
+
+struct function_summary_t {
+    const char* name;
+    summary_kind_t kind;
+    //Argument indexes, -1 if the summary does not use it
+    int buffer; //String, destination or first buffer
+    int source; //Source, second buffer or fill value
+    int size; //Maximum number of bytes, element size for fread
+    //The buffers end at the first null byte
+    bool string;
+};
+
+//Summary of a function by name, nullptr if it has none or the architecture is not supported
+const function_summary_t* find_summary(const char* callee);
+
+//Runs the call at pc natively and applies the summary when it returns
+void summarize_call(const function_summary_t* summary, ea_t pc, thid_t tid);
@@ -0,0 +1,220 @@
+//! \file
+/*
+**  Copyright (c) 2020 - Ponce
+**  Authors:
+**         Alberto Garcia Illera        agarciaillera@gmail.com
+**         Francisco Oca                francisco.oca.gonzalez@gmail.com
+**
+**  This program is under the terms of the BSD License.
+*/
+
+#include <unordered_map>
+
+//Ponce
+#include "taint_fast_path.hpp"
+#include "context.hpp"
+#include "globals.hpp"
+
+//Triton
+#include <triton/x86Specifications.hpp>
+
+using namespace triton::arch::x86;
+
+/*Only the instructions without implicit operands, apart from the flags and the stack, are here.
+rol, ror, inc, dec and not do not write every flag, Triton decides what happens to tainted flags*/
+static const std::unordered_map<triton::uint32, taint_rule_t> taint_rules = {
+    //                  reads dst   writes dst  reads flags writes flags
+    { ID_INS_MOV,       { false,    true,       false,      false } },
+    { ID_INS_MOVZX,     { false,    true,       false,      false } },
+    { ID_INS_MOVSX,     { false,    true,       false,      false } },
+    { ID_INS_MOVSXD,    { false,    true,       false,      false } },
+    { ID_INS_LEA,       { false,    true,       false,      false } },
+    { ID_INS_ADD,       { true,     true,       false,      true } },
+    { ID_INS_SUB,       { true,     true,       false,      true } },
+    { ID_INS_AND,       { true,     true,       false,      true } },
+    { ID_INS_OR,        { true,     true,       false,      true } },
+    { ID_INS_XOR,       { true,     true,       false,      true } },
+    { ID_INS_SHL,       { true,     true,       false,      true } },
+    { ID_INS_SHR,       { true,     true,       false,      true } },
+    { ID_INS_SAR,       { true,     true,       false,      true } },
+    { ID_INS_NEG,       { true,     true,       false,      true } },
+    { ID_INS_ROL,       { true,     true,       false,      false } },
+    { ID_INS_ROR,       { true,     true,       false,      false } },
+    { ID_INS_INC,       { true,     true,       false,      false } },
+    { ID_INS_DEC,       { true,     true,       false,      false } },
+    { ID_INS_NOT,       { true,     true,       false,      false } },
+    { ID_INS_ADC,       { true,     true,       true,       true } },
+    { ID_INS_SBB,       { true,     true,       true,       true } },
+    { ID_INS_CMP,       { true,     false,      false,      true } },
+    { ID_INS_TEST,      { true,     false,      false,      true } },
+    { ID_INS_NOP,       { false,    false,      false,      false } },
+    { ID_INS_JMP,       { true,     false,      false,      false } },
+    { ID_INS_JA,        { false,    false,      true,       false } },
+    { ID_INS_JAE,       { false,    false,      true,       false } },
+    { ID_INS_JB,        { false,    false,      true,       false } },
+    { ID_INS_JBE,       { false,    false,      true,       false } },
+    { ID_INS_JE,        { false,    false,      true,       false } },
+    { ID_INS_JNE,       { false,    false,      true,       false } },
+    { ID_INS_JG,        { false,    false,      true,       false } },
+    { ID_INS_JGE,       { false,    false,      true,       false } },
+    { ID_INS_JL,        { false,    false,      true,       false } },
+    { ID_INS_JLE,       { false,    false,      true,       false } },
+    { ID_INS_JS,        { false,    false,      true,       false } },
+    { ID_INS_JNS,       { false,    false,      true,       false } },
+    { ID_INS_JO,        { false,    false,      true,       false } },
+    { ID_INS_JNO,       { false,    false,      true,       false } },
+    { ID_INS_JP,        { false,    false,      true,       false } },
+    { ID_INS_JNP,       { false,    false,      true,       false } },
+    { ID_INS_SETE,      { false,    true,       true,       false } },
+    { ID_INS_SETNE,     { false,    true,       true,       false } },
+    { ID_INS_CMOVE,     { true,     true,       true,       false } },
+    { ID_INS_CMOVNE,    { true,     true,       true,       false } },
+    { ID_INS_PUSH,      { true,     false,      false,      false } },
+    { ID_INS_POP,       { false,    true,       false,      false } },
+    { ID_INS_CALL,      { true,     false,      false,      false } },
+    { ID_INS_RET,       { false,    false,      false,      false } },
+};
+
+static bool are_flags_tainted()
+{
+    return api.isRegisterTainted(api.registers.x86_cf) || api.isRegisterTainted(api.registers.x86_pf) ||
+        api.isRegisterTainted(api.registers.x86_af) || api.isRegisterTainted(api.registers.x86_zf) ||
+        api.isRegisterTainted(api.registers.x86_sf) || api.isRegisterTainted(api.registers.x86_of);
+}
+
+static void untaint_flags()
+{
+    api.untaintRegister(api.registers.x86_cf);
+    api.untaintRegister(api.registers.x86_pf);
+    api.untaintRegister(api.registers.x86_af);
+    api.untaintRegister(api.registers.x86_zf);
+    api.untaintRegister(api.registers.x86_sf);
+    api.untaintRegister(api.registers.x86_of);
+}
+
+static bool is_valid(const triton::arch::Register& reg)
+{
+    return reg.getId() != triton::arch::ID_REG_INVALID;
+}
+
+/*The address Triton computes in the semantics: base + index * scale + sign extended displacement. The instruction was
+not executed yet so the registers of the debugger are the ones it uses. Returns false for fs and gs, their base is not a register*/
+static bool get_memory_access(const triton::arch::Instruction& instruction, const triton::arch::MemoryAccess& operand, triton::arch::MemoryAccess& access)
+{
+    const auto& segment = operand.getConstSegmentRegister();
+    if (segment.getId() == api.registers.x86_fs.getId() || segment.getId() == api.registers.x86_gs.getId())
+        return false;
+
+    triton::uint64 address = 0;
+    const auto& base = operand.getConstBaseRegister();
+    if (is_valid(base)) {
+        if (base.getId() == api.registers.x86_rip.getId() || base.getId() == api.registers.x86_eip.getId())
+            address = instruction.getNextAddress();
+        else
+            address = IDA_getCurrentRegisterValue(base).convert_to<triton::uint64>();
+    }
+    const auto& index = operand.getConstIndexRegister();
+    if (is_valid(index))
+        address += IDA_getCurrentRegisterValue(index).convert_to<triton::uint64>() * operand.getConstScale().getValue();
+
+    const auto& displacement = operand.getConstDisplacement();
+    triton::uint64 value = displacement.getValue();
+    triton::uint32 bits = displacement.getBitSize();
+    if (bits && bits < 64 && (value >> (bits - 1)) & 1)
+        value |= ~(((triton::uint64)1 << bits) - 1);
+    address += value;
+
+    if (api.getGprBitSize() < 64)
+        address &= ((triton::uint64)1 << api.getGprBitSize()) - 1;
+    access = triton::arch::MemoryAccess(address, operand.getSize());
+    return true;
+}
+
+bool propagate_clean_instruction(triton::arch::Instruction& instruction, std::vector<triton::arch::MemoryAccess>& stores)
+{
+    if (api.getArchitecture() != triton::arch::ARCH_X86 && api.getArchitecture() != triton::arch::ARCH_X86_64)
+        return false;
+
+    try {
+        api.disassembly(instruction);
+    }
+    catch (const triton::exceptions::Exception&) {
+        return false;
+    }
+
+    auto it = taint_rules.find(instruction.getType());
+    if (it == taint_rules.end())
+        return false;
+    const taint_rule_t& rule = it->second;
+    auto type = instruction.getType();
+    bool stack_operation = type == ID_INS_PUSH || type == ID_INS_POP || type == ID_INS_CALL || type == ID_INS_RET;
+
+    bool partial_flags = type == ID_INS_ROL || type == ID_INS_ROR || type == ID_INS_INC || type == ID_INS_DEC || type == ID_INS_NOT;
+    if ((rule.reads_flags || partial_flags) && are_flags_tainted())
+        return false;
+    const auto& stack_pointer = api.getCpuInstance()->getStackPointer();
+    if (stack_operation && api.isRegisterTainted(stack_pointer))
+        return false;
+
+    // Every source must be clean
+    std::vector<triton::arch::MemoryAccess> accesses(instruction.operands.size());
+    for (size_t i = 0; i < instruction.operands.size(); i++) {
+        const auto& operand = instruction.operands[i];
+        bool source = i > 0 || rule.reads_destination;
+        switch (operand.getType()) {
+        case triton::arch::OP_REG:
+            if (source && api.isRegisterTainted(operand.getConstRegister()))
+                return false;
+            break;
+        case triton::arch::OP_MEM: {
+            const auto& memory = operand.getConstMemory();
+            // A tainted pointer spreads the taint with TAINT_THROUGH_POINTERS
+            if ((is_valid(memory.getConstBaseRegister()) && api.isRegisterTainted(memory.getConstBaseRegister())) ||
+                (is_valid(memory.getConstIndexRegister()) && api.isRegisterTainted(memory.getConstIndexRegister())))
+                return false;
+            if (!get_memory_access(instruction, memory, accesses[i]))
+                return false;
+            // lea only computes the address
+            if (source && type != ID_INS_LEA && api.isMemoryTainted(accesses[i]))
+                return false;
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    triton::uint64 sp = IDA_getCurrentRegisterValue(stack_pointer).convert_to<triton::uint64>();
+    triton::uint32 pointer_size = api.getGprSize();
+    if (type == ID_INS_POP) {
+        if (instruction.operands.empty() || api.isMemoryTainted(triton::arch::MemoryAccess(sp, instruction.operands[0].getSize())))
+            return false;
+    }
+    else if (type == ID_INS_RET) {
+        // A tainted return address taints the program counter
+        if (api.isMemoryTainted(triton::arch::MemoryAccess(sp, pointer_size)))
+            return false;
+    }
+    else if (type == ID_INS_PUSH || type == ID_INS_CALL) {
+        triton::uint32 size = type == ID_INS_PUSH && !instruction.operands.empty() && instruction.operands[0].getType() != triton::arch::OP_IMM ? instruction.operands[0].getSize() : pointer_size;
+        triton::arch::MemoryAccess slot(sp - size, size);
+        api.untaintMemory(slot);
+        stores.push_back(slot);
+    }
+
+    if (rule.writes_destination && !instruction.operands.empty()) {
+        const auto& destination = instruction.operands[0];
+        if (destination.getType() == triton::arch::OP_REG) {
+            api.untaintRegister(destination.getConstRegister());
+        }
+        else if (destination.getType() == triton::arch::OP_MEM) {
+            api.untaintMemory(accesses[0]);
+            stores.push_back(accesses[0]);
+        }
+    }
+    if (rule.writes_flags)
+        untaint_flags();
+
+    instruction.setTaint(false);
+    return true;
+}
@@ -0,0 +1,39 @@
+//! \file
+/*
+**  Copyright (c) 2020 - Ponce
+**  Authors:
+**         Alberto Garcia Illera        agarciaillera@gmail.com
+**         Francisco Oca                francisco.oca.gonzalez@gmail.com
+**
+**  This program is under the terms of the BSD License.
+*/
+
+/*Fast path of the tainting engine. Most of the traced instructions do not read any tainted value, the only effect
+they have on the taint is removing it from what they write. For the common x86 instructions that is done here from the
+decoded operands, without building the semantics and the ASTs of api.processing().
+The instructions reading a tainted value, or not in the rules, still go through Triton so the comments and the
+propagation are exactly the same*/
+
+#pragma once
+
+#include <vector>
+
+//Triton
+#include <triton/api.hpp>
+
+//What the explicit operands of an instruction do. operands[0] is the destination
+struct taint_rule_t {
+    //operands[0] is also a source
+    bool reads_destination;
+    //operands[0] is written
+    bool writes_destination;
+    //The condition flags are a source
+    bool reads_flags;
+    //cf, pf, af, zf, sf and of are set from the operands
+    bool writes_flags;
+};
+
+/*Returns true if the instruction does not read any tainted value and its taint effect was applied. The memory written is
+added to stores since the instruction has no store accesses without the semantics.
+Returns false if the instruction must be processed by Triton*/
+bool propagate_clean_instruction(triton::arch::Instruction& instruction, std::vector<triton::arch::MemoryAccess>& stores);
@@ -0,0 +1,494 @@
+//! \file
+/*
+**  Copyright (c) 2020 - Ponce
+**  Authors:
+**         Alberto Garcia Illera        agarciaillera@gmail.com
+**         Francisco Oca                francisco.oca.gonzalez@gmail.com
+**
+**  This program is under the terms of the BSD License.
+*/
+
+#include <cstring>
+
+#include "trace_format.hpp"
+
+//The records are kept in memory until we have this many bytes
+#define TRACE_BUFFER_SIZE (1 << 16)
+
+const char* trace_edit_name(triton::uint8 edit) {
+    switch (edit) {
+    case TRACE_EDIT_SOLUTION: return "solution injected";
+    case TRACE_EDIT_RESTORE_SNAPSHOT: return "snapshot restored";
+    default: return "unknown edit";
+    }
+}
+
+
+TraceWriter::TraceWriter() {
+    this->next_pc = 0;
+    this->last_memory_address = 0;
+    this->last_thread_id = 0;
+    this->number_of_instructions = 0;
+    this->size = 0;
+}
+
+
+TraceWriter::~TraceWriter() {
+    this->close();
+}
+
+
+bool TraceWriter::open(const std::string& path, triton::uint8 architecture, triton::uint8 flags) {
+    this->close();
+    this->file.open(path, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!this->file.is_open())
+        return false;
+
+    this->buffer.reserve(TRACE_BUFFER_SIZE);
+    this->next_pc = 0;
+    this->last_memory_address = 0;
+    this->last_thread_id = 0;
+    this->known_opcodes.clear();
+    this->number_of_instructions = 0;
+    this->size = 0;
+
+    /* Header: magic, version, architecture, flags and a reserved byte */
+    for (int i = 0; i < TRACE_MAGIC_SIZE; i++)
+        this->putByte(TRACE_MAGIC[i]);
+    this->putByte(TRACE_VERSION);
+    this->putByte(architecture);
+    this->putByte(flags);
+    this->putByte(0);
+    return true;
+}
+
+
+void TraceWriter::close(void) {
+    if (!this->file.is_open())
+        return;
+    this->flush();
+    this->file.close();
+}
+
+
+bool TraceWriter::isOpen(void) const {
+    return this->file.is_open();
+}
+
+
+void TraceWriter::writeInstruction(triton::uint64 pc, triton::uint32 thread_id, const triton::uint8* opcodes, triton::uint32 size) {
+    if (thread_id != this->last_thread_id) {
+        this->putByte(TRACE_TAG_THREAD);
+        this->putVarint(thread_id);
+        this->last_thread_id = thread_id;
+    }
+
+    /* We only write the opcodes the first time we see an address or if they changed (self modifying code) */
+    auto& known = this->known_opcodes[pc];
+    if (known.size() == size && std::memcmp(known.data(), opcodes, size) == 0) {
+        this->putByte(TRACE_TAG_INSTRUCTION);
+        this->putSignedVarint((triton::sint64)(pc - this->next_pc));
+    }
+    else {
+        known.assign(opcodes, opcodes + size);
+        this->putByte(TRACE_TAG_INSTRUCTION_OPCODES);
+        this->putSignedVarint((triton::sint64)(pc - this->next_pc));
+        this->putByte((triton::uint8)size);
+        for (triton::uint32 i = 0; i < size; i++)
+            this->putByte(opcodes[i]);
+    }
+
+    this->next_pc = pc + size;
+    this->number_of_instructions++;
+}
+
+
+void TraceWriter::writeMemoryValue(triton::uint64 address, triton::uint32 size, const triton::uint512& value) {
+    this->putByte(TRACE_TAG_MEMORY);
+    this->putSignedVarint((triton::sint64)(address - this->last_memory_address));
+    this->putByte((triton::uint8)size);
+    this->putValue(value, size);
+    this->last_memory_address = address;
+}
+
+
+void TraceWriter::writeRegisterValue(triton::uint32 register_id, triton::uint32 size, const triton::uint512& value) {
+    this->putByte(TRACE_TAG_REGISTER);
+    this->putVarint(register_id);
+    this->putByte((triton::uint8)size);
+    this->putValue(value, size);
+}
+
+
+void TraceWriter::writeSymbolizeMemory(triton::uint64 address, triton::uint32 size) {
+    this->putByte(TRACE_TAG_SYMBOLIZE_MEMORY);
+    this->putVarint(address);
+    this->putVarint(size);
+}
+
+
+void TraceWriter::writeSymbolizeRegister(triton::uint32 register_id) {
+    this->putByte(TRACE_TAG_SYMBOLIZE_REGISTER);
+    this->putVarint(register_id);
+}
+
+
+void TraceWriter::writeEngineEdit(trace_edit_e edit) {
+    this->putByte(TRACE_TAG_ENGINE_EDIT);
+    this->putByte((triton::uint8)edit);
+}
+
+
+void TraceWriter::writeConcretizeRegister(triton::uint32 register_id) {
+    this->putByte(TRACE_TAG_CONCRETIZE_REGISTER);
+    this->putVarint(register_id);
+}
+
+
+void TraceWriter::writeConcretizeMemory(triton::uint64 address, triton::uint32 size) {
+    this->putByte(TRACE_TAG_CONCRETIZE_MEMORY);
+    this->putVarint(address);
+    this->putVarint(size);
+}
+
+
+void TraceWriter::writeSummary(const summary_effect_t& effect) {
+    this->putByte(TRACE_TAG_SUMMARY);
+    this->putByte(effect.kind);
+    this->putVarint(effect.buffer);
+    this->putVarint(effect.source);
+    this->putVarint(effect.bytes);
+    this->putVarint(effect.padding);
+    this->putVarint(effect.result);
+    this->putVarint(effect.register_id);
+    this->putByte(effect.string ? 1 : 0);
+    this->putVarint(effect.name.size());
+    for (char c : effect.name)
+        this->putByte((triton::uint8)c);
+}
+
+
+void TraceWriter::writeErasePathConstraints(triton::uint64 first, triton::uint64 count) {
+    this->putByte(TRACE_TAG_ERASE_CONSTRAINTS);
+    this->putVarint(first);
+    this->putVarint(count);
+}
+
+
+triton::uint64 TraceWriter::getNumberOfInstructions(void) const {
+    return this->number_of_instructions;
+}
+
+
+triton::uint64 TraceWriter::getSize(void) const {
+    return this->size;
+}
+
+
+void TraceWriter::putByte(triton::uint8 byte) {
+    this->buffer.push_back(byte);
+    this->size++;
+    if (this->buffer.size() >= TRACE_BUFFER_SIZE)
+        this->flush();
+}
+
+
+/* LEB128 */
+void TraceWriter::putVarint(triton::uint64 value) {
+    while (value >= 0x80) {
+        this->putByte((triton::uint8)(value | 0x80));
+        value >>= 7;
+    }
+    this->putByte((triton::uint8)value);
+}
+
+
+/* Zigzag encoding so small negative deltas are small varints too */
+void TraceWriter::putSignedVarint(triton::sint64 value) {
+    this->putVarint(((triton::uint64)value << 1) ^ (triton::uint64)(value >> 63));
+}
+
+
+void TraceWriter::putValue(const triton::uint512& value, triton::uint32 size) {
+    /* Almost every value fits in 64 bits, avoid the multiprecision shifts for them */
+    if (size <= sizeof(triton::uint64)) {
+        triton::uint64 value64 = value.convert_to<triton::uint64>();
+        for (triton::uint32 i = 0; i < size; i++)
+            this->putByte((triton::uint8)(value64 >> (i * 8)));
+        return;
+    }
+    for (triton::uint32 i = 0; i < size; i++)
+        this->putByte(((value >> (i * 8)) & 0xff).convert_to<triton::uint8>());
+}
+
+
+void TraceWriter::flush(void) {
+    if (!this->buffer.empty()) {
+        this->file.write(reinterpret_cast<const char*>(this->buffer.data()), this->buffer.size());
+        this->buffer.clear();
+    }
+}
+
+
+TraceReader::TraceReader() {
+    this->position = 0;
+    this->available = 0;
+    this->architecture = 0;
+    this->flags = 0;
+    this->next_pc = 0;
+    this->last_memory_address = 0;
+    this->thread_id = 0;
+    this->corrupted = false;
+}
+
+
+bool TraceReader::open(const std::string& path) {
+    this->file.open(path, std::ios::in | std::ios::binary);
+    if (!this->file.is_open())
+        return false;
+
+    this->buffer.resize(TRACE_BUFFER_SIZE);
+    this->position = 0;
+    this->available = 0;
+
+    triton::uint8 header[TRACE_MAGIC_SIZE + 4];
+    for (auto& byte : header) {
+        if (!this->getByte(byte))
+            return false;
+    }
+    if (std::memcmp(header, TRACE_MAGIC, TRACE_MAGIC_SIZE) != 0 || header[TRACE_MAGIC_SIZE] != TRACE_VERSION)
+        return false;
+
+    this->architecture = header[TRACE_MAGIC_SIZE + 1];
+    this->flags = header[TRACE_MAGIC_SIZE + 2];
+    return true;
+}
+
+
+bool TraceReader::next(trace_record_t& record) {
+    triton::uint8 tag;
+    this->corrupted = false;
+
+    while (this->getByte(tag)) {
+        /* Every record but the tag can not end at the end of the file, from here any failure means the trace is corrupted */
+        this->corrupted = true;
+        switch (tag) {
+        case TRACE_TAG_THREAD:
+        {
+            triton::uint64 thread_id;
+            if (!this->getVarint(thread_id))
+                return false;
+            this->thread_id = (triton::uint32)thread_id;
+            this->corrupted = false;
+            continue;
+        }
+        case TRACE_TAG_INSTRUCTION:
+        case TRACE_TAG_INSTRUCTION_OPCODES:
+        {
+            triton::sint64 delta;
+            if (!this->getSignedVarint(delta))
+                return false;
+            record.type = TRACE_TAG_INSTRUCTION;
+            record.address = this->next_pc + delta;
+            record.thread_id = this->thread_id;
+
+            auto& known = this->known_opcodes[record.address];
+            if (tag == TRACE_TAG_INSTRUCTION_OPCODES) {
+                triton::uint8 size;
+                if (!this->getByte(size) || size > TRACE_MAX_OPCODE_SIZE)
+                    return false;
+                known.resize(size);
+                for (auto& byte : known) {
+                    if (!this->getByte(byte))
+                        return false;
+                }
+            }
+            /* An instruction without opcodes must have been seen before */
+            else if (known.empty()) {
+                return false;
+            }
+
+            record.size = (triton::uint32)known.size();
+            std::memcpy(record.opcodes, known.data(), known.size());
+            this->next_pc = record.address + record.size;
+            this->corrupted = false;
+            return true;
+        }
+        case TRACE_TAG_MEMORY:
+        {
+            triton::sint64 delta;
+            triton::uint8 size;
+            if (!this->getSignedVarint(delta) || !this->getByte(size) || !this->getValue(record.value, size))
+                return false;
+            record.type = TRACE_TAG_MEMORY;
+            record.address = this->last_memory_address + delta;
+            record.size = size;
+            this->last_memory_address = record.address;
+            this->corrupted = false;
+            return true;
+        }
+        case TRACE_TAG_REGISTER:
+        {
+            triton::uint64 register_id;
+            triton::uint8 size;
+            if (!this->getVarint(register_id) || !this->getByte(size) || !this->getValue(record.value, size))
+                return false;
+            record.type = TRACE_TAG_REGISTER;
+            record.register_id = (triton::uint32)register_id;
+            record.size = size;
+            this->corrupted = false;
+            return true;
+        }
+        case TRACE_TAG_SYMBOLIZE_MEMORY:
+        {
+            triton::uint64 address, size;
+            if (!this->getVarint(address) || !this->getVarint(size))
+                return false;
+            record.type = TRACE_TAG_SYMBOLIZE_MEMORY;
+            record.address = address;
+            record.size = (triton::uint32)size;
+            this->corrupted = false;
+            return true;
+        }
+        case TRACE_TAG_SYMBOLIZE_REGISTER:
+        {
+            triton::uint64 register_id;
+            if (!this->getVarint(register_id))
+                return false;
+            record.type = TRACE_TAG_SYMBOLIZE_REGISTER;
+            record.register_id = (triton::uint32)register_id;
+            this->corrupted = false;
+            return true;
+        }
+        case TRACE_TAG_ENGINE_EDIT:
+        {
+            if (!this->getByte(record.edit))
+                return false;
+            record.type = TRACE_TAG_ENGINE_EDIT;
+            this->corrupted = false;
+            return true;
+        }
+        case TRACE_TAG_CONCRETIZE_REGISTER:
+        {
+            triton::uint64 register_id;
+            if (!this->getVarint(register_id))
+                return false;
+            record.type = TRACE_TAG_CONCRETIZE_REGISTER;
+            record.register_id = (triton::uint32)register_id;
+            this->corrupted = false;
+            return true;
+        }
+        case TRACE_TAG_CONCRETIZE_MEMORY:
+        case TRACE_TAG_ERASE_CONSTRAINTS:
+        {
+            triton::uint64 address, size;
+            if (!this->getVarint(address) || !this->getVarint(size))
+                return false;
+            record.type = (trace_record_e)tag;
+            record.address = address;
+            record.size = (triton::uint32)size;
+            this->corrupted = false;
+            return true;
+        }
+        case TRACE_TAG_SUMMARY:
+        {
+            auto& effect = record.effect;
+            triton::uint64 register_id, name_size;
+            triton::uint8 string;
+            if (!this->getByte(effect.kind) || !this->getVarint(effect.buffer) || !this->getVarint(effect.source) || !this->getVarint(effect.bytes)
+                || !this->getVarint(effect.padding) || !this->getVarint(effect.result) || !this->getVarint(register_id) || !this->getByte(string)
+                || !this->getVarint(name_size) || name_size > TRACE_MAX_NAME_SIZE)
+                return false;
+            effect.register_id = (triton::uint32)register_id;
+            effect.string = string != 0;
+            effect.name.resize((size_t)name_size);
+            for (auto& c : effect.name) {
+                triton::uint8 byte;
+                if (!this->getByte(byte))
+                    return false;
+                c = (char)byte;
+            }
+            record.type = TRACE_TAG_SUMMARY;
+            this->corrupted = false;
+            return true;
+        }
+        default:
+            return false;
+        }
+    }
+    return false;
+}
+
+
+bool TraceReader::isCorrupted(void) const {
+    return this->corrupted;
+}
+
+
+triton::uint8 TraceReader::getArchitecture(void) const {
+    return this->architecture;
+}
+
+
+triton::uint8 TraceReader::getFlags(void) const {
+    return this->flags;
+}
+
+
+bool TraceReader::getByte(triton::uint8& byte) {
+    if (this->position == this->available) {
+        this->file.read(reinterpret_cast<char*>(this->buffer.data()), this->buffer.size());
+        this->available = (size_t)this->file.gcount();
+        this->position = 0;
+        if (this->available == 0)
+            return false;
+    }
+    byte = this->buffer[this->position++];
+    return true;
+}
+
+
+bool TraceReader::getVarint(triton::uint64& value) {
+    triton::uint8 byte;
+    value = 0;
+    for (unsigned int shift = 0; shift < 64; shift += 7) {
+        if (!this->getByte(byte))
+            return false;
+        value |= (triton::uint64)(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0)
+            return true;
+    }
+    return false;
+}
+
+
+bool TraceReader::getSignedVarint(triton::sint64& value) {
+    triton::uint64 zigzag;
+    if (!this->getVarint(zigzag))
+        return false;
+    value = (triton::sint64)(zigzag >> 1) ^ -(triton::sint64)(zigzag & 1);
+    return true;
+}
+
+
+bool TraceReader::getValue(triton::uint512& value, triton::uint32 size) {
+    triton::uint8 bytes[64];
+    if (size > sizeof(bytes))
+        return false;
+    for (triton::uint32 i = 0; i < size; i++) {
+        if (!this->getByte(bytes[i]))
+            return false;
+    }
+
+    if (size <= sizeof(triton::uint64)) {
+        triton::uint64 value64 = 0;
+        for (triton::uint32 i = 0; i < size; i++)
+            value64 |= (triton::uint64)bytes[i] << (i * 8);
+        value = value64;
+        return true;
+    }
+    value = 0;
+    for (triton::uint32 i = size; i > 0; i--)
+        value = (value << 8) | bytes[i - 1];
+    return true;
+}
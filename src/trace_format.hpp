@@ -0,0 +1,247 @@
+//! \file
+/*
+**  Copyright (c) 2020 - Ponce
+**  Authors:
+**         Alberto Garcia Illera        agarciaillera@gmail.com
+**         Francisco Oca                francisco.oca.gonzalez@gmail.com
+**
+**  This program is under the terms of the BSD License.
+*/
+
+/*This file defines the on-disk format of the Ponce execution traces. It must not depend on IDA
+since it is shared with the offline tools.
+
+A trace is a header followed by a stream of records. Every record starts with a tag byte:
+    TRACE_TAG_INSTRUCTION          pc delta                                  (opcodes already seen at that pc)
+    TRACE_TAG_INSTRUCTION_OPCODES  pc delta, size, opcodes                   (first time we see that pc or it was modified)
+    TRACE_TAG_THREAD               thread id                                 (only when the traced thread changes)
+    TRACE_TAG_MEMORY               address delta, size, value                (concrete memory value given to Triton)
+    TRACE_TAG_REGISTER             register id, size, value                  (concrete register value given to Triton)
+    TRACE_TAG_SYMBOLIZE_MEMORY     address, size                             (the user symbolized or tainted memory)
+    TRACE_TAG_SYMBOLIZE_REGISTER   register id                               (the user symbolized or tainted a register)
+    TRACE_TAG_ENGINE_EDIT          trace_edit_e                              (Ponce changed the engine state in a way that can not be replayed)
+    TRACE_TAG_CONCRETIZE_REGISTER  register id                               (concretized and untainted, after a skipped call)
+    TRACE_TAG_CONCRETIZE_MEMORY    address, size                             (concretized, dead stack)
+    TRACE_TAG_SUMMARY              kind, buffer, source, bytes, padding,     (effect of a summarized call, see engine_edits.hpp)
+                                   result, register id, string, name
+    TRACE_TAG_ERASE_CONSTRAINTS    first, count                              (path constraints removed, window or loop summary)
+The pc delta is relative to the address following the previous instruction, so sequential code costs one byte.
+The memory address delta is relative to the previous memory record. Deltas are zigzag encoded LEB128 varints.
+Values are stored little endian using exactly size bytes.
+The memory and register records following an instruction record are the values Triton asked for while processing it.
+The symbolize records are written before the concrete values of what is being symbolized and take effect before the next instruction.
+The changes Ponce does to the engines between two instructions (skipped and summarized calls, garbage collection, loop
+summaries) are written before the concrete values they need and take effect before the next instruction, like the symbolize records.
+The injected solutions and the restored snapshots are not recorded, only the fact that one happened. The symbolic state built by a
+replay is not the one Ponce had after them, so a trace containing one is not replayable.
+The names are stored as their size followed by their characters.*/
+
+#pragma once
+
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//Triton
+#include <triton/tritonTypes.hpp>
+
+//Ponce
+#include "engine_edits.hpp"
+
+#define TRACE_MAGIC "PONCETRC"
+#define TRACE_MAGIC_SIZE 8
+#define TRACE_VERSION 3
+#define TRACE_MAX_OPCODE_SIZE 16
+#define TRACE_MAX_NAME_SIZE 256
+
+enum trace_record_e {
+    TRACE_TAG_INSTRUCTION = 1,
+    TRACE_TAG_INSTRUCTION_OPCODES = 2,
+    TRACE_TAG_THREAD = 3,
+    TRACE_TAG_MEMORY = 4,
+    TRACE_TAG_REGISTER = 5,
+    TRACE_TAG_SYMBOLIZE_MEMORY = 6,
+    TRACE_TAG_SYMBOLIZE_REGISTER = 7,
+    TRACE_TAG_ENGINE_EDIT = 8,
+    TRACE_TAG_CONCRETIZE_REGISTER = 9,
+    TRACE_TAG_CONCRETIZE_MEMORY = 10,
+    TRACE_TAG_SUMMARY = 11,
+    TRACE_TAG_ERASE_CONSTRAINTS = 12,
+};
+
+//The changes Ponce does to the engine state that can not be replayed from the trace
+enum trace_edit_e {
+    TRACE_EDIT_SOLUTION = 1,
+    TRACE_EDIT_RESTORE_SNAPSHOT = 2,
+};
+
+//Returns a printable name for a trace_edit_e
+const char* trace_edit_name(triton::uint8 edit);
+
+//The engine configuration used while recording, so the trace can be replayed with the same one
+enum trace_flags_e {
+    TRACE_FLAG_TAINT_ENGINE = 1 << 0,
+    TRACE_FLAG_AST_OPTIMIZATIONS = 1 << 1,
+    TRACE_FLAG_CONCRETIZE_UNDEFINED_REGISTERS = 1 << 2,
+    TRACE_FLAG_CONSTANT_FOLDING = 1 << 3,
+    TRACE_FLAG_SYMBOLIZE_INDEX_ROTATION = 1 << 4,
+    TRACE_FLAG_TAINT_THROUGH_POINTERS = 1 << 5,
+};
+
+//A decoded record. Instruction records come with the current thread id, thread records are consumed by the reader
+struct trace_record_t {
+    trace_record_e type;
+    //The pc for instructions, the address for memory values and symbolized or concretized memory, the first erased path constraint
+    triton::uint64 address = 0;
+    triton::uint32 thread_id = 0;
+    triton::uint32 register_id = 0;
+    //The trace_edit_e of engine edits
+    triton::uint8 edit = 0;
+    //Opcodes size for instructions, value size in bytes for memory and registers, symbolized or concretized memory size,
+    //number of erased path constraints
+    triton::uint32 size = 0;
+    triton::uint8 opcodes[TRACE_MAX_OPCODE_SIZE];
+    triton::uint512 value = 0;
+    //Summary records
+    summary_effect_t effect;
+};
+
+//! \class TraceWriter
+//! \brief Appends records to a compact execution trace.
+class TraceWriter {
+
+private:
+    //! The trace file.
+    std::ofstream file;
+
+    //! Records not written to disk yet.
+    std::vector<triton::uint8> buffer;
+
+    //! Address following the last instruction. Sequential instructions are encoded relative to it.
+    triton::uint64 next_pc;
+
+    //! Address of the last memory record.
+    triton::uint64 last_memory_address;
+
+    //! Thread of the last instruction record.
+    triton::uint32 last_thread_id;
+
+    //! Opcodes already written for every pc, so we only write them again for self modifying code.
+    std::unordered_map<triton::uint64, std::vector<triton::uint8>> known_opcodes;
+
+    //! Number of instruction records written.
+    triton::uint64 number_of_instructions;
+
+    //! Number of bytes written, including the header.
+    triton::uint64 size;
+
+    void putByte(triton::uint8 byte);
+    void putVarint(triton::uint64 value);
+    void putSignedVarint(triton::sint64 value);
+    void putValue(const triton::uint512& value, triton::uint32 size);
+    void flush(void);
+
+public:
+    //! Constructor.
+    TraceWriter();
+
+    //! Destructor. Flushes the pending records.
+    ~TraceWriter();
+
+    //! Creates the trace file and writes the header. Returns false if the file can not be created.
+    bool open(const std::string& path, triton::uint8 architecture, triton::uint8 flags);
+
+    //! Flushes the pending records and closes the file.
+    void close(void);
+
+    //! Returns true if there is a trace being written.
+    bool isOpen(void) const;
+
+    //! Appends an executed instruction.
+    void writeInstruction(triton::uint64 pc, triton::uint32 thread_id, const triton::uint8* opcodes, triton::uint32 size);
+
+    //! Appends a concrete memory value.
+    void writeMemoryValue(triton::uint64 address, triton::uint32 size, const triton::uint512& value);
+
+    //! Appends a concrete register value.
+    void writeRegisterValue(triton::uint32 register_id, triton::uint32 size, const triton::uint512& value);
+
+    //! Appends a memory range symbolized or tainted by the user.
+    void writeSymbolizeMemory(triton::uint64 address, triton::uint32 size);
+
+    //! Appends a register symbolized or tainted by the user.
+    void writeSymbolizeRegister(triton::uint32 register_id);
+
+    //! Appends a change done by Ponce to the engine state that can not be replayed.
+    void writeEngineEdit(trace_edit_e edit);
+
+    //! Appends a register concretized and untainted by Ponce.
+    void writeConcretizeRegister(triton::uint32 register_id);
+
+    //! Appends a memory range concretized by Ponce.
+    void writeConcretizeMemory(triton::uint64 address, triton::uint32 size);
+
+    //! Appends the effect of a summarized call.
+    void writeSummary(const summary_effect_t& effect);
+
+    //! Appends path constraints removed by Ponce.
+    void writeErasePathConstraints(triton::uint64 first, triton::uint64 count);
+
+    //! Returns the number of instruction records written.
+    triton::uint64 getNumberOfInstructions(void) const;
+
+    //! Returns the size of the trace in bytes.
+    triton::uint64 getSize(void) const;
+};
+
+//! \class TraceReader
+//! \brief Reads back the records written by TraceWriter.
+class TraceReader {
+
+private:
+    //! The trace file.
+    std::ifstream file;
+
+    //! Bytes read from disk and not consumed yet.
+    std::vector<triton::uint8> buffer;
+    size_t position;
+    size_t available;
+
+    //! Header information.
+    triton::uint8 architecture;
+    triton::uint8 flags;
+
+    //! Decoding state, the mirror of the TraceWriter one.
+    triton::uint64 next_pc;
+    triton::uint64 last_memory_address;
+    triton::uint32 thread_id;
+    std::unordered_map<triton::uint64, std::vector<triton::uint8>> known_opcodes;
+
+    //! Set if the trace ends in the middle of a record or has an unknown tag.
+    bool corrupted;
+
+    bool getByte(triton::uint8& byte);
+    bool getVarint(triton::uint64& value);
+    bool getSignedVarint(triton::sint64& value);
+    bool getValue(triton::uint512& value, triton::uint32 size);
+
+public:
+    //! Constructor.
+    TraceReader();
+
+    //! Opens a trace and reads its header. Returns false if it is not a valid trace.
+    bool open(const std::string& path);
+
+    //! Reads the next record. Returns false at the end of the trace or if it is corrupted.
+    bool next(trace_record_t& record);
+
+    //! Returns true if the last call to next() failed because the trace is corrupted.
+    bool isCorrupted(void) const;
+
+    //! Returns the triton::arch::architecture_e the trace was recorded with.
+    triton::uint8 getArchitecture(void) const;
+
+    //! Returns the trace_flags_e the trace was recorded with.
+    triton::uint8 getFlags(void) const;
+};
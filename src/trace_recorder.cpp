@@ -0,0 +1,166 @@
+//! \file
+/*
+**  Copyright (c) 2020 - Ponce
+**  Authors:
+**         Alberto Garcia Illera        agarciaillera@gmail.com
+**         Francisco Oca                francisco.oca.gonzalez@gmail.com
+**
+**  This program is under the terms of the BSD License.
+*/
+
+//Ponce
+#include "trace_recorder.hpp"
+#include "globals.hpp"
+
+//IDA
+#include <kernwin.hpp>
+
+TraceRecorder::TraceRecorder() {
+    this->deferred = false;
+    this->edited = false;
+}
+
+
+bool TraceRecorder::start(const char* path, bool deferred) {
+    /* We save the engine configuration so the replay uses the same one */
+    triton::uint8 flags = 0;
+    flags |= cmdOptions.use_tainting_engine ? TRACE_FLAG_TAINT_ENGINE : 0;
+    flags |= cmdOptions.AST_OPTIMIZATIONS ? TRACE_FLAG_AST_OPTIMIZATIONS : 0;
+    flags |= cmdOptions.CONCRETIZE_UNDEFINED_REGISTERS ? TRACE_FLAG_CONCRETIZE_UNDEFINED_REGISTERS : 0;
+    flags |= cmdOptions.CONSTANT_FOLDING ? TRACE_FLAG_CONSTANT_FOLDING : 0;
+    flags |= cmdOptions.SYMBOLIZE_INDEX_ROTATION ? TRACE_FLAG_SYMBOLIZE_INDEX_ROTATION : 0;
+    flags |= cmdOptions.TAINT_THROUGH_POINTERS ? TRACE_FLAG_TAINT_THROUGH_POINTERS : 0;
+
+    if (!this->writer.open(path, (triton::uint8)api.getArchitecture(), flags)) {
+        msg("[!] Could not create the trace file %s\n", path);
+        return false;
+    }
+    this->path = path;
+    this->deferred = deferred;
+    this->edited = false;
+
+    /* The user could have symbolized or tainted something before we started recording, the replay needs to know it */
+    if (cmdOptions.use_tainting_engine) {
+        for (const auto& address : api.getTaintedMemory()) {
+            this->writer.writeSymbolizeMemory(address, 1);
+            this->writer.writeMemoryValue(address, 1, api.getConcreteMemoryValue(address, false));
+        }
+        for (const auto* reg : api.getTaintedRegisters()) {
+            this->writer.writeSymbolizeRegister(reg->getId());
+            this->writer.writeRegisterValue(reg->getId(), reg->getSize(), api.getConcreteRegisterValue(*reg, false));
+        }
+    }
+    else {
+        for (const auto& [id, symVar] : api.getSymbolicVariables()) {
+            if (symVar->getType() == triton::engines::symbolic::variable_e::MEMORY_VARIABLE) {
+                auto mem = triton::arch::MemoryAccess(symVar->getOrigin(), symVar->getSize() / 8);
+                this->writer.writeSymbolizeMemory(mem.getAddress(), mem.getSize());
+                this->writer.writeMemoryValue(mem.getAddress(), mem.getSize(), api.getConcreteMemoryValue(mem, false));
+            }
+            else if (symVar->getType() == triton::engines::symbolic::variable_e::REGISTER_VARIABLE) {
+                auto reg = api.getRegister((triton::arch::register_e)symVar->getOrigin());
+                this->writer.writeSymbolizeRegister(reg.getId());
+                this->writer.writeRegisterValue(reg.getId(), reg.getSize(), api.getConcreteRegisterValue(reg, false));
+            }
+        }
+    }
+
+    /* Triton only runs the concrete semantics (we still need it to know the memory and registers every instruction reads)
+    The symbolic and taint analysis will be done by the replay */
+    if (this->deferred) {
+        api.getSymbolicEngine()->enable(false);
+        api.getTaintEngine()->enable(false);
+    }
+
+    msg("[+] Recording trace to %s%s\n", path, deferred ? " (symbolic processing deferred)" : "");
+    return true;
+}
+
+
+void TraceRecorder::stop(void) {
+    if (!this->writer.isOpen())
+        return;
+
+    this->writer.close();
+    if (this->deferred) {
+        api.getTaintEngine()->enable(cmdOptions.use_tainting_engine);
+        api.getSymbolicEngine()->enable(true);
+        this->deferred = false;
+    }
+
+    msg("[+] Trace saved to %s. %llu instructions, %llu bytes%s\n", this->path.c_str(), (unsigned long long)this->writer.getNumberOfInstructions(), (unsigned long long)this->writer.getSize(), this->edited ? " (not replayable)" : "");
+}
+
+
+bool TraceRecorder::isRecording(void) const {
+    return this->writer.isOpen();
+}
+
+
+bool TraceRecorder::isDeferred(void) const {
+    return this->deferred;
+}
+
+
+void TraceRecorder::recordInstruction(ea_t pc, thid_t tid, const cached_instruction_t* instruction) {
+    if (this->writer.isOpen())
+        this->writer.writeInstruction(pc, (triton::uint32)tid, instruction->opcodes, instruction->size);
+}
+
+
+void TraceRecorder::recordMemoryValue(ea_t address, triton::uint32 size, const triton::uint512& value) {
+    if (this->writer.isOpen())
+        this->writer.writeMemoryValue(address, size, value);
+}
+
+
+void TraceRecorder::recordRegisterValue(const triton::arch::Register& reg, const triton::uint512& value) {
+    if (this->writer.isOpen())
+        this->writer.writeRegisterValue(reg.getId(), reg.getSize(), value);
+}
+
+
+void TraceRecorder::recordSymbolizeMemory(ea_t address, triton::uint32 size) {
+    if (this->writer.isOpen())
+        this->writer.writeSymbolizeMemory(address, size);
+}
+
+
+void TraceRecorder::recordSymbolizeRegister(const triton::arch::Register& reg) {
+    if (this->writer.isOpen())
+        this->writer.writeSymbolizeRegister(reg.getId());
+}
+
+
+void TraceRecorder::recordEngineEdit(trace_edit_e edit) {
+    if (!this->writer.isOpen())
+        return;
+    if (!this->edited)
+        msg("[!] %s while recording, the trace %s will not be replayable\n", trace_edit_name(edit), this->path.c_str());
+    this->edited = true;
+    this->writer.writeEngineEdit(edit);
+}
+
+
+void TraceRecorder::recordConcretizeRegister(const triton::arch::Register& reg) {
+    if (this->writer.isOpen())
+        this->writer.writeConcretizeRegister(reg.getId());
+}
+
+
+void TraceRecorder::recordConcretizeMemory(ea_t address, triton::uint32 size) {
+    if (this->writer.isOpen())
+        this->writer.writeConcretizeMemory(address, size);
+}
+
+
+void TraceRecorder::recordSummary(const summary_effect_t& effect) {
+    if (this->writer.isOpen())
+        this->writer.writeSummary(effect);
+}
+
+
+void TraceRecorder::recordErasePathConstraints(size_t first, size_t count) {
+    if (this->writer.isOpen())
+        this->writer.writeErasePathConstraints(first, count);
+}
@@ -0,0 +1,88 @@
+//! \file
+/*
+**  Copyright (c) 2020 - Ponce
+**  Authors:
+**         Alberto Garcia Illera        agarciaillera@gmail.com
+**         Francisco Oca                francisco.oca.gonzalez@gmail.com
+**
+**  This program is under the terms of the BSD License.
+*/
+
+#pragma once
+
+#include <string>
+
+//Triton
+#include <triton/api.hpp>
+
+//IDA
+#include <pro.h>
+#include <idd.hpp>
+
+//Ponce
+#include "trace_format.hpp"
+#include "instruction_cache.hpp"
+
+//! \class TraceRecorder
+//! \brief Records the traced instructions and the concrete values given to Triton so they can be replayed offline.
+class TraceRecorder {
+
+private:
+    //! The trace being written.
+    TraceWriter writer;
+
+    //! Where the trace is being written.
+    std::string path;
+
+    //! Set once Ponce changed the engine state outside of the instructions, the trace can not be replayed anymore.
+    bool edited;
+
+    //! If set, the symbolic and taint engines are disabled while recording and the analysis is done when replaying.
+    bool deferred;
+
+public:
+    //! Constructor.
+    TraceRecorder();
+
+    //! Starts recording to path. Returns false if the trace can not be created.
+    bool start(const char* path, bool deferred);
+
+    //! Stops recording and closes the trace.
+    void stop(void);
+
+    //! Returns true if we are recording.
+    bool isRecording(void) const;
+
+    //! Returns true if the symbolic processing is being deferred to the replay.
+    bool isDeferred(void) const;
+
+    //! Records an instruction about to be processed by Triton.
+    void recordInstruction(ea_t pc, thid_t tid, const cached_instruction_t* instruction);
+
+    //! Records a concrete memory value given to Triton.
+    void recordMemoryValue(ea_t address, triton::uint32 size, const triton::uint512& value);
+
+    //! Records a concrete register value given to Triton.
+    void recordRegisterValue(const triton::arch::Register& reg, const triton::uint512& value);
+
+    //! Records a memory range symbolized or tainted by the user. Must be called before asking for its concrete value.
+    void recordSymbolizeMemory(ea_t address, triton::uint32 size);
+
+    //! Records a register symbolized or tainted by the user. Must be called before asking for its concrete value.
+    void recordSymbolizeRegister(const triton::arch::Register& reg);
+
+    //! Records a change done by Ponce to the engine state that the replay can not reproduce.
+    void recordEngineEdit(trace_edit_e edit);
+
+    //! Records a register concretized and untainted by Ponce.
+    void recordConcretizeRegister(const triton::arch::Register& reg);
+
+    //! Records a memory range concretized by Ponce.
+    void recordConcretizeMemory(ea_t address, triton::uint32 size);
+
+    //! Records the effect of a summarized call. Must be called before applying it.
+    void recordSummary(const summary_effect_t& effect);
+
+    //! Records path constraints removed by Ponce.
+    void recordErasePathConstraints(size_t first, size_t count);
+};
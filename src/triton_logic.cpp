@@ -4,6 +4,12 @@
 #include "utils.hpp"
 #include "context.hpp"
 #include "blacklist.hpp"
+#include "instruction_cache.hpp"
+#include "memory_cache.hpp"
+#include "solver_job.hpp"
+#include "solver.hpp"
+#include "taint_fast_path.hpp"
+#include "garbage_collector.hpp"
 
 #include <ida.hpp>
 #include <dbg.hpp>
@@ -13,7 +19,7 @@
     Returns:
     0 instruction tritonized
     1 trigger is not activated
-    2 other error*/
+    2 other error (pc is 0, the instruction can not be decoded or it is not supported by Triton)*/
 int tritonize(ea_t pc, thid_t threadID)
 {
     /*Check that the runtime Trigger is on just in case*/
@@ -22,6 +28,13 @@ int tritonize(ea_t pc, thid_t threadID)
 
     threadID = threadID ? threadID : get_current_thread();
 
+    //The solver job reads the engine we are about to change
+    stop_solver_job();
+
+    //The memory and registers could have been modified since the last debugger event (the user can edit them while the process is suspended)
+    invalidate_memory_cache();
+    invalidate_register_cache();
+
     if (pc == 0) {
         msg("[!] Some error at tritonize since pc is 0\n");
         return 2;
@@ -30,68 +43,72 @@ int tritonize(ea_t pc, thid_t threadID)
     // Show analized instruction in IDA UI
     show_addr(pc);
 
-    //We delete the last_instruction
-    if (ponce_runtime_status.last_triton_instruction != nullptr) {
-        delete ponce_runtime_status.last_triton_instruction;
-        ponce_runtime_status.last_triton_instruction = nullptr;
-    }
-
-    triton::arch::Instruction* tritonInst = new triton::arch::Instruction();
+    //The pool owns the instruction, last_triton_instruction only borrows it
+    triton::arch::Instruction* tritonInst = instruction_pool.acquire();
     ponce_runtime_status.last_triton_instruction = tritonInst;
 
-    /*This will fill the 'cmd' (to get the instruction size) which is a insn_t structure https://www.hex-rays.com/products/ida/support/sdkdoc/classinsn__t.html */
-    if (!can_decode(pc)) {
+    /* Setup Triton information */
+    tritonInst->setAddress(pc);
+    tritonInst->setThreadId(threadID);
+
+    /*We only ask IDA to decode the instruction the first time we see it. An instruction that can not be decoded is
+    not supported by Triton either, last_triton_instruction keeps its address so the callbacks don't tritonize it twice*/
+    const cached_instruction_t* cached_instruction = get_cached_instruction(pc);
+    if (cached_instruction == nullptr) {
         msg("[!] Some error decoding instruction at " MEM_FORMAT "\n", pc);
+        return 2;
     }
+    tritonInst->setOpcode(cached_instruction->opcodes, cached_instruction->size);
 
-    unsigned char opcodes[15];
-    ssize_t item_size = 0x0;
-
-    insn_t ins;
-    decode_insn(&ins, pc);
-    item_size = ins.size;
-    assert(item_size < sizeof(opcodes));
-    get_bytes(&opcodes, item_size, pc, GMB_READALL, NULL);
+    //The concrete values Triton asks for while processing it are recorded by the context callbacks
+    trace_recorder.recordInstruction(pc, threadID, cached_instruction);
 
-    /* Setup Triton information */
-    tritonInst->clear(); // ToDo: I think this is not necesary
-    tritonInst->setOpcode((triton::uint8*)opcodes, item_size);
-    tritonInst->setAddress(pc);
-    tritonInst->setThreadId(threadID);
+    /*In taint mode the instructions not reading any tainted value only untaint what they write, they don't need the
+    Triton semantics. The replay needs the values Triton asks for, so everything is processed while recording*/
+    std::vector<triton::arch::MemoryAccess> stores;
+    bool clean = cmdOptions.use_tainting_engine && !trace_recorder.isRecording() && propagate_clean_instruction(*tritonInst, stores);
 
-    try {
-        if (!api.processing(*tritonInst)) {
+    if (!clean) {
+        try {
+            if (!api.processing(*tritonInst)) {
+                msg("[!] Instruction at " MEM_FORMAT " not supported by Triton: %s (Thread id: %d)\n", pc, tritonInst->getDisassembly().c_str(), threadID);
+                return 2;
+            }
+        }
+        catch (const triton::exceptions::Exception& e) {
             msg("[!] Instruction at " MEM_FORMAT " not supported by Triton: %s (Thread id: %d)\n", pc, tritonInst->getDisassembly().c_str(), threadID);
             return 2;
         }
-    }
-    catch (const triton::exceptions::Exception& e) {
-        msg("[!] Instruction at " MEM_FORMAT " not supported by Triton: %s (Thread id: %d)\n", pc, tritonInst->getDisassembly().c_str(), threadID);
-        return 2;
+        for (const auto& [memory_access, node] : tritonInst->getStoreAccess())
+            stores.push_back(memory_access);
     }
 
     if (cmdOptions.showExtraDebugInfo) {
         msg("[+] Triton at " MEM_FORMAT " : %s (Thread id: %d)\n", pc, tritonInst->getDisassembly().c_str(), threadID);
     }
 
+    for (const auto& memory_access : stores) {
+        //If the instruction writes over code we have already decoded we need to decode it again
+        invalidate_instruction_cache((ea_t)memory_access.getAddress(), memory_access.getSize());
+    }
+
     /*In the case that the snapshot engine is in use we should track every memory write access*/
     if (snapshot.exists())  {
-        for (const auto& [memory_access, node]: tritonInst->getStoreAccess()){
+        for (const auto& memory_access : stores){
             auto addr = memory_access.getAddress();
-            //This is the way to force IDA to read the value from the debugger
-            //More info here: https://www.hex-rays.com/products/ida/support/sdkdoc/dbg_8hpp.html#ac67a564945a2c1721691aa2f657a908c
-            invalidate_dbgmem_contents((ea_t)addr, memory_access.getSize()); //ToDo: Do I have to call this for every byte in memory I want to read?
-            for (unsigned int i = 0; i < memory_access.getSize(); i++) {
-                triton::uint128 value = 0;
-                //We get the memory readed
-                get_bytes(&value, 1, (ea_t)addr + i, GMB_READALL, NULL);
-
-                //We add a meomory modification to the snapshot engine
-                snapshot.addModification((ea_t)addr + i, value.convert_to<char>());
-            }
+            //We get the memory about to be written. The instruction was not executed yet
+            uint8 value[64] = { 0 };
+            if (ponce_get_bytes(value, memory_access.getSize(), (ea_t)addr) != (ssize_t)memory_access.getSize())
+                continue;
+            //We add a meomory modification to the snapshot engine
+            snapshot.addModification((ea_t)addr, value, memory_access.getSize());
         }
     }
 
+    /*When the symbolic processing is deferred to the replay there is nothing to annotate*/
+    if (trace_recorder.isDeferred())
+        return 0;
+
     /* Don't write nothing on symbolic/tainted branch instructions instructions because I'll do it later*/
     if (cmdOptions.addCommentsControlledOperands && !tritonInst->isBranch()){
         comment_controlled_operands(tritonInst, pc);
@@ -101,10 +118,13 @@ int tritonize(ea_t pc, thid_t threadID)
         add_symbolic_expressions(tritonInst, pc);
 
     //We only paint the executed instructions if they don't have a previous color
-    if (get_item_color(pc) == DEFCOLOR && cmdOptions.color_executed_instruction != DEFCOLOR) {
+    if (ponce_get_item_color(pc) == DEFCOLOR && cmdOptions.color_executed_instruction != DEFCOLOR) {
         ponce_set_item_color(pc, cmdOptions.color_executed_instruction);
     }
-    
+
+    //Nothing tainted, and the program counter of Triton was not updated for the loop detection
+    if (clean)
+        return 0;
 
     //ToDo: The isSymbolized is missidentifying like "user-controlled" some instructions: https://github.com/JonathanSalwan/Triton/issues/383
     if (tritonInst->isTainted() || tritonInst->isSymbolized()) {
@@ -134,7 +154,19 @@ int tritonize(ea_t pc, thid_t threadID)
         }
     }
 
+    if (tritonInst->isBranch()) {
+        //Triton already moved its program counter to the next instruction. The program counter of the architecture
+        //of the target, REG_XIP is the one of the IDA build
+        const auto& program_counter = api.getCpuInstance()->getProgramCounter();
+        ea_t target = (ea_t)api.getConcreteRegisterValue(program_counter, false).convert_to<triton::uint64>();
+        if (loop_detector.addBranch(pc, target) && cmdOptions.showDebugInfo)
+            msg("[+] Loop detected between " MEM_FORMAT " and " MEM_FORMAT ", %u iterations\n", target, pc, LOOP_HOT_ITERATIONS);
+    }
+
     if (tritonInst->isBranch() && tritonInst->isSymbolized()) {
+        if (cmdOptions.summarizeLoops && summarize_loop_constraint(pc) && cmdOptions.showExtraDebugInfo)
+            msg("[+] Path constraint of the previous iteration at " MEM_FORMAT " summarized\n", pc);
+        branch_index.update();
         ea_t addr1 = (ea_t)tritonInst->getNextAddress();
         ea_t addr2 = (ea_t)tritonInst->operands[0].getImmediate().getValue();
         if (cmdOptions.showDebugInfo) {
@@ -181,8 +213,12 @@ bool ponce_set_triton_architecture() {
 /*This functions is called every time a new debugger session starts*/
 void triton_restart_engines()
 {
+    //The solver job reads the engine and the recorder we are about to reset
+    stop_solver_job();
     if (cmdOptions.showDebugInfo)
         msg("[+] Restarting triton engines...\n");
+    //A trace only makes sense for a single debugging session
+    trace_recorder.stop();
     //We need to set the architecture for Triton
     ponce_set_triton_architecture();
     //We reset everything at the beginning
@@ -194,10 +230,8 @@ void triton_restart_engines()
     //If we are in taint analysis mode we enable only the tainting engine and disable the symbolic one
     api.getTaintEngine()->enable(cmdOptions.use_tainting_engine);
     api.getSymbolicEngine()->enable(true);
-    if (ponce_runtime_status.last_triton_instruction) {
-        delete ponce_runtime_status.last_triton_instruction;
-        ponce_runtime_status.last_triton_instruction = nullptr;
-    }
+    instruction_pool.reset();
+    ponce_runtime_status.last_triton_instruction = nullptr;
 
     // This modes cannot be configured by the user. They are allways on
     api.setMode(triton::modes::ALIGNED_MEMORY, true);
@@ -220,8 +254,15 @@ void triton_restart_engines()
     ponce_runtime_status.total_number_symbolic_ins = 0;
     ponce_runtime_status.total_number_symbolic_conditions = 0;
     ponce_runtime_status.current_trace_counter = 0;
+    clear_instruction_cache();
+    clear_blacklist_cache();
+    incremental_solver.reset();
+    clear_enumerations();
+    loop_detector.reset();
+    branch_index.invalidate();
     breakpoint_pending_actions.clear();
     clear_requests_queue();
+    reset_memory_budget_warning();
 
 }
 
@@ -13,6 +13,7 @@
 #include <string>
 #include <iostream>
 #include <fstream>
+#include <unordered_map>
 //Used in GetTimeMs64
 #ifdef _WIN32
 #include <Windows.h>
@@ -39,6 +40,7 @@
 #include "context.hpp"
 #include "blacklist.hpp"
 #include "callbacks.hpp"
+#include "memory_cache.hpp"
 
 
 
@@ -137,10 +139,8 @@ ea_t get_args_pointer(int argument_number, bool skip_ret)
 {
     int skip_ret_index = skip_ret ? 1 : 0;
 #if !defined(__EA64__)
-    regval_t esp_value;
-    invalidate_dbg_state(DBGINV_REGS);
-    get_reg_val("esp", &esp_value);
-    ea_t arg = (ea_t)esp_value.ival + (argument_number + skip_ret_index) * 4;
+    ea_t esp = (ea_t)IDA_getCurrentRegisterValue(api.registers.x86_esp).convert_to<ea_t>();
+    ea_t arg = esp + (argument_number + skip_ret_index) * 4;
     return arg;
 #else
     //Not converted to IDA we should use get_reg_val
@@ -180,10 +180,7 @@ ea_t get_args_pointer(int argument_number, bool skip_ret)
 short read_unicode_char_from_ida(ea_t address)
 {
     short value;
-    //This is the way to force IDA to read the value from the debugger
-    //More info here: https://www.hex-rays.com/products/ida/support/sdkdoc/dbg_8hpp.html#ac67a564945a2c1721691aa2f657a908c
-    invalidate_dbgmem_contents(address, sizeof(value));
-    ssize_t bytes_read = get_bytes(&value, sizeof(value), address, GMB_READALL, NULL);
+    ssize_t bytes_read = ponce_get_bytes(&value, sizeof(value), address);
     if (bytes_read == 0 || bytes_read == -1) {
         msg("[!] Error reading memory from " MEM_FORMAT "\n", address);
     }
@@ -194,10 +191,7 @@ short read_unicode_char_from_ida(ea_t address)
 char read_char_from_ida(ea_t address)
 {
     char value;
-    //This is the way to force IDA to read the value from the debugger
-    //More info here: https://www.hex-rays.com/products/ida/support/sdkdoc/dbg_8hpp.html#ac67a564945a2c1721691aa2f657a908c
-    invalidate_dbgmem_contents(address, sizeof(value));
-    ssize_t bytes_read = get_bytes(&value, sizeof(value), address, GMB_READALL, NULL);
+    ssize_t bytes_read = ponce_get_bytes(&value, sizeof(value), address);
     if (bytes_read == 0 || bytes_read == -1) {
         msg("[!] Error reading memory from " MEM_FORMAT "\n", address);
     }
@@ -207,10 +201,7 @@ char read_char_from_ida(ea_t address)
 ea_t read_regSize_from_ida(ea_t address)
 {
     ea_t value;
-    //This is the way to force IDA to read the value from the debugger
-    //More info here: https://www.hex-rays.com/products/ida/support/sdkdoc/dbg_8hpp.html#ac67a564945a2c1721691aa2f657a908c
-    invalidate_dbgmem_contents(address, sizeof(value));
-    ssize_t bytes_read = get_bytes(&value, sizeof(value), address, GMB_READALL, NULL);
+    ssize_t bytes_read = ponce_get_bytes(&value, sizeof(value), address);
     if (bytes_read == 0 || bytes_read == -1) {
         msg("[!] Error reading memory from " MEM_FORMAT "\n", address);
     }
@@ -471,20 +462,52 @@ ea_t current_instruction()
     return xip;
 }
 
+/*The comments and colors are written to the IDB in batches. Reading and writing the database for every traced
+instruction was a big part of the cost of a step in the hot loops*/
+struct pending_annotation_t {
+    qstring comment;
+    bool rptble = false;
+    bool has_comment = false;
+    //Times the comment was set, including the ones already in the IDB
+    int hits = 0;
+    bgcolor_t color = DEFCOLOR;
+    bool has_color = false;
+};
+static std::unordered_map<ea_t, pending_annotation_t> pending_annotations;
+
+static void flush_annotation(ea_t ea, const pending_annotation_t& pending) {
+    if (pending.has_comment)
+        set_cmt(ea, pending.comment.c_str(), pending.rptble);
+    if (pending.has_color)
+        set_item_color(ea, pending.color);
+}
+
+void flush_annotations() {
+    for (const auto& [ea, pending] : pending_annotations)
+        flush_annotation(ea, pending);
+    pending_annotations.clear();
+}
+
+bgcolor_t ponce_get_item_color(ea_t ea) {
+    auto it = pending_annotations.find(ea);
+    if (it != pending_annotations.end() && it->second.has_color)
+        return it->second.color;
+    return get_item_color(ea);
+}
+
 /* This function deletes all the comments and colour made by Ponce Plugin everytime that the Ponce
 engine is restarted with another run. We do this to prevent polluting the IDA UI*/
 void delete_ponce_comments() {
+    //The annotations not written yet are dropped, ponce_comments already has them
+    pending_annotations.clear();
     unsigned int count_comments = 0;
     unsigned int count_colors = 0;
-    ea_t snapshot_address = 0;
-    for (auto& [address, insinfo]: ponce_comments) {      
+    for (const auto& [address, insinfo]: ponce_comments.getAll()) {      
         if (!insinfo.comment.empty()) { //comment
             set_cmt(address, "", false);
             count_comments++;
         }
         if (!insinfo.snapshot_comment.empty()) { //extra comment
-            if (snapshot.exists())
-                snapshot_address = address;
             set_cmt(address, "", false);
         }
         if (insinfo.color != DEFCOLOR) { //color
@@ -495,48 +518,61 @@ void delete_ponce_comments() {
     ponce_comments.clear();
     msg("[+] Deleted %u comments and %u colored addresses\n", count_comments, count_colors);
 
-    // If snapshot exists lets put it back
-    if (snapshot_address) {
-        ponce_set_cmt(snapshot_address, "Snapshot taken here", false, true);
-    }
+    // If there are snapshots lets put their comments back
+    snapshot.addComments();
+    flush_annotations();
 }
 
 void ponce_set_item_color(ea_t ea, bgcolor_t color) {
-    //if it is a new color we add it to ponce_comments
-    if (ponce_comments.count(ea) > 0) {
-        ponce_comments[ea].color = color;
-    }
-    else {
-        struct instruction_info insinfo;
-        insinfo.color = color;
-        ponce_comments[ea] = insinfo;
+    ponce_comments.get(ea).color = color;
+    auto& pending = pending_annotations[ea];
+    pending.color = color;
+    pending.has_color = true;
+}
+
+/*Hits of the comment already in the IDB: 0 if there is none, the count of a "N hits. " comment or 1 for any other one*/
+static int get_comment_hits(ea_t ea, bool rptble) {
+    qstring buf;
+    if (get_cmt(&buf, ea, rptble) == -1)
+        return 0;
+    auto first_space = strchr(buf.c_str(), ' ');
+    // there is a previous comment. Let's try to get the hit count
+    if (first_space) {
+        try {
+            return std::stoi(std::string(buf.c_str(), first_space - buf.c_str()));
+        }
+        catch (...) {}
     }
-    set_item_color(ea, color);
+    return 1;
 }
 
 /* Wrapper to keep track of added comments so we can delete them after*/
 bool ponce_set_cmt(ea_t ea, const char* comm, bool rptble, bool snapshot) {
-    qstring buf;
+    auto& pending = pending_annotations[ea];
+    if (pending.has_comment && pending.rptble != rptble) {
+        // Only a comment of each kind is buffered
+        flush_annotation(ea, pending);
+        pending.has_color = false;
+        pending.has_comment = false;
+    }
+    if (!pending.has_comment) {
+        //We only ask the IDB the first time in a batch
+        pending.hits = get_comment_hits(ea, rptble);
+        pending.rptble = rptble;
+        pending.has_comment = true;
+    }
+
     qstring new_comment;
-    if (get_cmt(&buf, ea, rptble) != -1) {
-        auto first_space = strchr(buf.c_str(), ' ');
-        // there is a previous comment. Let's try to get the hit count
-        if (first_space){
-            try {
-                auto n_hit = std::stoi(std::string(buf.c_str(), first_space - buf.c_str()));
-                new_comment.sprnt("%d hits. %s", ++n_hit, comm);
-                //return set_cmt(ea, new_comment.c_str(), rptble);
-            }
-            catch (...) {}
-        }
-        if(new_comment.empty()){
-            new_comment.sprnt("%d hits. %s", 2, comm);
-            //return set_cmt(ea, new_comment.c_str(), rptble);     
-        }
+    if (comm[0] == '\0') { //The comment is deleted
+        pending.hits = 0;
+    }
+    else if (++pending.hits > 1) {
+        new_comment.sprnt("%d hits. %s", pending.hits, comm);
     }
     else { //its a new comment
         new_comment = comm;
     }
+    pending.comment = new_comment;
 
     auto new_line_pos = new_comment.find('\n');
     /* Lets only get the text about Symbolic/Taint instruction not the memory or
@@ -547,23 +583,12 @@ bool ponce_set_cmt(ea_t ea, const char* comm, bool rptble, bool snapshot) {
     else
         pseudocode_comment = std::string(new_comment.c_str());
 
-    //if it is a new comment we add it to ponce_comments
-    if (ponce_comments.count(ea) > 0) {
-        if (snapshot)
-            ponce_comments[ea].snapshot_comment = pseudocode_comment;
-        else
-            ponce_comments[ea].comment = pseudocode_comment;
-    }
-    else  {
-        struct instruction_info insinfo;
-        if (snapshot)
-            insinfo.snapshot_comment = pseudocode_comment;
-        else
-            insinfo.comment = pseudocode_comment;
-
-        ponce_comments[ea] = insinfo;
-    }
-    return set_cmt(ea, new_comment.c_str(), rptble);
+    auto& insinfo = ponce_comments.get(ea);
+    if (snapshot)
+        insinfo.snapshot_comment = pseudocode_comment;
+    else
+        insinfo.comment = pseudocode_comment;
+    return true;
 }
 
 /*This function gets the tainted operands for an instruction and add a comment to that instruction with this info*/
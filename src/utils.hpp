@@ -38,4 +38,6 @@ ea_t current_instruction();
 void delete_ponce_comments();
 bool ponce_set_cmt(ea_t ea, const char* comm, bool rptble, bool snapshot = false);
 void ponce_set_item_color(ea_t ea, bgcolor_t color);
+bgcolor_t ponce_get_item_color(ea_t ea);
+void flush_annotations();
 void comment_controlled_operands(triton::arch::Instruction* tritonInst, ea_t pc);
\ No newline at end of file